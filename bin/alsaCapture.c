@@ -21,6 +21,8 @@ int main(int argc, char **argv)
   qsApp->op_showControlbar =false;
   qsApp->op_height = 200;
   qsApp->op_showWindowBorder = false;
+  // --thread reads the sound in a separate thread
+  qsApp->op_captureThread = qsApp_bool("thread", false);
 
 #if 0 // Idle or Other
   // qsIdle_create() makes a scope controller that just keeps
@@ -76,6 +78,8 @@ int main(int argc, char **argv)
       true, /* lines */ 1, 0, 0 /* RGB line color */);
 
   qsTrace_setSwipeX(trace, true);
+  // --peak draws with peak detect
+  qsTrace_setPeakDetect(trace, qsApp_bool("peak", false));
 
   qsApp_main();
   qsApp_destroy();
@@ -13,6 +13,8 @@ int main(int argc, char **argv)
   qsApp->op_fade = false;
   qsApp->op_doubleBuffer = true;
   qsApp->op_grid = 0;
+  // --renderThread draws each window in its own thread
+  qsApp->op_renderThread = qsApp_bool("renderThread", false);
 
   s = qsRossler_create( 5000 /* maxNumFrames */,
       5/*play rate multiplier*/,
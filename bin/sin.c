@@ -16,6 +16,14 @@ int main(int argc, char **argv)
   qsApp->op_fadePeriod = 9.0F;
   qsApp->op_fadeDelay =  0.6F;
   qsApp->op_doubleBuffer = true;
+  // --frameBuffer draws with XShmPutImage()
+  qsApp->op_frameBuffer = qsApp_bool("frameBuffer", false);
+  // --fadeThreads=N fade draws with N threads, with the frame buffer
+  qsApp->op_fadeThreads = qsApp_int("fadeThreads", 0);
+  // --fadeEngine=1 is the phosphor fade, 2 is the hit density display
+  qsApp->op_fadeEngine = qsApp_int("fadeEngine", QS_FADE_QUEUE);
+  // --gl draws with OpenGL, if built with --enable-gl
+  qsApp->op_gl = qsApp_bool("gl", false);
   qsApp->op_grid = 0;
   qsApp->op_axis = false;
 
@@ -11,6 +11,7 @@
 #include "debug.h"
 #include "Assert.h"
 #include "app.h"
+#include "app_priv.h"
 #include "base.h"
 #include "adjuster.h"
 #include "adjuster_priv.h"
@@ -190,11 +191,15 @@ void _qsWidget_inc(struct QsWidget *w)
 
   if(adj->inc)
   {
+    // The value changes in inc(), and the render threads may be
+    // drawing with it.
+    _qsApp_renderPause();
     if(adj->inc(adj, w))
     {
       if(adj->changeValueCallback) adj->changeValueCallback(adj->data);
       _qsWidget_display(w);
     }
+    _qsApp_renderResume();
   }
 }
 
@@ -206,11 +211,13 @@ void _qsWidget_dec(struct QsWidget *w)
 
   if(adj->dec)
   {
+    _qsApp_renderPause();
     if(adj->dec(adj, w))
     {
       if(adj->changeValueCallback) adj->changeValueCallback(adj->data);
       _qsWidget_display(w);
     }
+    _qsApp_renderResume();
   }
 }
 
@@ -28,6 +28,7 @@
 #include "iterator.h"
 #include "rungeKutta.h"
 #include "sourceParticular.h"
+#include "captureThread_priv.h"
 
 // TODO: make this thread safe and cleaner
 static int createCount = 0;
@@ -38,6 +39,9 @@ struct QsAlsaCapture
   snd_pcm_t *handle;
   int id, sampleRate;
   int frames; // frames per source read callback
+  // If set, snd_pcm_readi() is called in this thread
+  // and not in the source read callback.
+  struct QsCaptureThread *thread;
 };
 
 static
@@ -100,6 +104,70 @@ bool ReadNFrames(snd_pcm_t *handle, float *buf, snd_pcm_uframes_t n)
   return false; // success
 }
 
+// This is called in the capture thread.
+static
+int threadRead(snd_pcm_t *handle, float *buf, int n)
+{
+  if(ReadNFrames(handle, buf, (snd_pcm_uframes_t) n))
+    return -1; // fail
+  return n;
+}
+
+// The source read callback for when we have a capture thread doing the
+// blocking snd_pcm_readi() calls.  We write the frames that the capture
+// thread has ready, which may be less than nFrames, and we never block
+// waiting for more.
+static
+int cb_threadRead(struct QsAlsaCapture *s,
+    long double tf, long double prevT,
+    long double currentT,
+    long double dt, int nFrames,
+    bool underrun)
+{
+  struct QsSource *source;
+  source = (struct QsSource *) s;
+  int ret = 0;
+
+  QS_ASSERT(s->thread);
+
+  if(underrun)
+    // Skip the oldest frames like in cb_read().
+    _qsCaptureThread_skip(s->thread, nFrames);
+
+  while(nFrames)
+  {
+    float *frames;
+    long double *t;
+    int n;
+
+    n = _qsCaptureThread_available(s->thread);
+    if(n == 0)
+      break;
+    if(n > nFrames)
+      n = nFrames;
+
+    frames = qsSource_setFrames(source, &t, &n);
+
+    // This will read n frames because we checked that
+    // they are available.
+    if(_qsCaptureThread_read(s->thread, frames, n) != n)
+      return -1; // fail
+
+    nFrames -= n;
+    ret = 1;
+
+    if(dt)
+      // This is the master source
+      for(; n; --n)
+        *t++ = (currentT += dt);
+  }
+
+  if(g_atomic_int_get(&s->thread->failed))
+    return -1;
+
+  return ret;
+}
+
 static
 int cb_read(struct QsAlsaCapture *s,
     long double tf, long double prevT,
@@ -178,6 +246,10 @@ void _qsAlsaCapture_destroy(struct QsAlsaCapture *s)
 {
   QS_ASSERT(s);
   QS_ASSERT(s->handle);
+  if(s->thread)
+    // Stop the thread before we close the handle
+    // that it is reading from.
+    _qsCaptureThread_destroy(s->thread);
   snd_pcm_drain(s->handle);
   snd_pcm_close(s->handle);
 }
@@ -254,6 +326,17 @@ struct QsSource *qsAlsaCapture_create(int maxNumFrames,
   s->id = createCount++;
   s->sampleRate = sampleRate;
 
+  if(qsApp->op_captureThread)
+  {
+    // The capture thread gets a ring buffer that can hold
+    // about a quarter second of sound.
+    s->thread = _qsCaptureThread_create(
+        (int (*)(void *, float *, int)) threadRead, handle,
+        s->frames, sampleRate/4);
+    qsSource_setReadFunc((struct QsSource *) s,
+        (QsSource_ReadFunc_t) cb_threadRead);
+  }
+
   // TODO: figure out what the sample rate really is.
   // TODO: make this QS_SELECTABLE
   qsSource_setFrameRateType((struct QsSource *) s, QS_FIXED, NULL, sampleRate);
@@ -174,6 +174,7 @@ struct QsApp *qsApp_init(int *argc, char ***argv)
   qsApp->op_savePNG_alpha = 1.0F;
 
   qsApp->op_bufferFactor = 1.5F;
+  qsApp->op_pointBufferSize = 0x10000;
 
   qsApp->op_doubleBuffer = true; /* use XPixmap to double buffer */
   qsApp->op_grid = true; /* background grid */
@@ -189,6 +190,12 @@ struct QsApp *qsApp_init(int *argc, char ***argv)
 
   qsApp->op_defaultIntervalPeriod = 1.0/60.0;
   qsApp->op_exitOnNoSourceWins = true;
+  qsApp->op_captureThread = false;
+  qsApp->op_frameBuffer = false;
+  qsApp->op_fadeThreads = 0;
+  qsApp->op_fadeEngine = QS_FADE_QUEUE;
+  qsApp->op_renderThread = false;
+  qsApp->op_gl = false;
 
   // win geometry
   qsApp->op_x = INT_MAX;
@@ -400,6 +407,9 @@ void qsApp_destroy(void)
   while(qsApp->wins)
     qsWin_destroy((struct QsWin *) qsApp->wins->data);
 
+  // Finish writing any window snapshots.
+  _qsWin_snapshotCleanup();
+
   _qsApp_freeArgv();
 
   _qsTimer_destroy(qsApp->timer);
@@ -64,6 +64,11 @@ struct QsApp
   // with more than one value for each channel.
   float op_bufferFactor;
 
+  // The most points we buffer before sending them to the X server.
+  // The point buffer is this or the number of pixels in the window,
+  // whichever is less.  It's allocated at window resize.
+  int op_pointBufferSize;
+
   bool op_doubleBuffer, /* with XPixmap */
         op_grid, /* draw background grid */
         op_axis, /* draw X and Y axis */
@@ -84,6 +89,32 @@ struct QsApp
   // Use gtk_widget_add_tick_callback() if true
   bool op_syncFadeDraw; // or uses g_timeout_add_full()
 
+  // Capture sources, like from qsAlsaCapture_create(), do their
+  // blocking device reads in a separate thread if this is set.
+  bool op_captureThread;
+
+  // Draw into an in process frame buffer that is sent to the X
+  // server with XShmPutImage(), instead of drawing with XDrawPoints().
+  // This only works with 24 and 32 bit TrueColor visuals.
+  bool op_frameBuffer;
+
+  // The number of threads that fade draw, including the main thread.
+  // Less than 2 means fade drawing is not threaded.  Fade threads are
+  // only used with the frame buffer (op_frameBuffer).
+  int op_fadeThreads;
+
+  // enum QsFadeEngine, QS_FADE_QUEUE, QS_FADE_PHOSPHOR, or
+  // QS_FADE_DENSITY
+  int op_fadeEngine;
+
+  // Each window gets a render thread with its own X11 connection
+  // that draws its traces, so that windows draw in parallel.
+  bool op_renderThread;
+
+  // Draw with OpenGL in a GtkGLArea, and not with libX11.  This is
+  // ignored if libquickscope was not built with --enable-gl.
+  bool op_gl;
+
   bool inAppLevel; // to see where we are in gtk_main(),
     // qsApp_main() and qsApp_destroy();
   bool freezeDisplay; // freeze display of all windows view ports
@@ -8,3 +8,10 @@
 // in gtk_main().
 extern
 void _qsApp_checkDestroy();
+
+// Pause and resume all the window render threads (op_renderThread),
+// so that the main thread may change things that they draw with.
+extern
+void _qsApp_renderPause(void);
+extern
+void _qsApp_renderResume(void);
@@ -0,0 +1,118 @@
+/* Quickscope - a software oscilloscope
+ * Copyright (C) 2012-2014  Lance Arsenault
+ * GNU General Public License version 3
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <gtk/gtk.h>
+
+#include "debug.h"
+#include "Assert.h"
+#include "captureThread_priv.h"
+
+
+static
+gpointer captureThread(struct QsCaptureThread *ct)
+{
+  guint mask;
+  mask = ct->len - 1;
+
+  // Where we put values when the consumer is too slow, so that the
+  // device read keeps up with the device anyway.
+  float *dropBuf;
+  dropBuf = g_malloc(sizeof(float)*ct->chunk);
+
+  while(g_atomic_int_get(&ct->running))
+  {
+    guint w, space, n, offset;
+    w = ct->writeIndex;
+    space = ct->len - (w - (guint) g_atomic_int_get(&ct->readIndex));
+    offset = w & mask;
+    n = ct->chunk;
+    // Read only into the contiguous part of the buffer.
+    if(n > ct->len - offset)
+      n = ct->len - offset;
+
+    if(n > space)
+    {
+      // The consumer is not keeping up.  We read into the drop
+      // buffer and throw these values away.  The newest values
+      // are dropped, the values the consumer has not read yet are
+      // never written to.
+      if(ct->read(ct->data, dropBuf, ct->chunk) < 0)
+        break;
+      g_atomic_int_inc(&ct->overruns);
+      continue;
+    }
+
+    int ret;
+    ret = ct->read(ct->data, &ct->buf[offset], n);
+    if(ret < 0)
+      break;
+    QS_ASSERT(ret <= n);
+
+    // g_atomic_int_set() is a memory barrier so that the consumer
+    // sees the values in ct->buf before it sees the new writeIndex.
+    g_atomic_int_set(&ct->writeIndex, (gint) (w + ret));
+  }
+
+  if(g_atomic_int_get(&ct->running))
+    // We got here from a read() failure.
+    g_atomic_int_set(&ct->failed, 1);
+
+  g_free(dropBuf);
+  return NULL;
+}
+
+struct QsCaptureThread *_qsCaptureThread_create(
+    int (*read)(void *data, float *buf, int n), void *data,
+    int chunk, int len)
+{
+  struct QsCaptureThread *ct;
+  QS_ASSERT(read);
+  QS_ASSERT(chunk > 0);
+
+  if(len < 2*chunk)
+    len = 2*chunk;
+  // Round up to a power of 2 so we can mask the free running
+  // indexes.
+  guint l = 1;
+  while(l < len)
+    l <<= 1;
+
+  ct = g_malloc0(sizeof(*ct));
+  ct->read = read;
+  ct->data = data;
+  ct->chunk = chunk;
+  ct->len = l;
+  ct->buf = g_malloc(sizeof(float)*l);
+  ct->running = 1;
+
+  ct->thread = g_thread_new("QsCaptureThread",
+      (GThreadFunc) captureThread, ct);
+
+  return ct;
+}
+
+void _qsCaptureThread_destroy(struct QsCaptureThread *ct)
+{
+  QS_ASSERT(ct);
+  QS_ASSERT(ct->thread);
+
+  g_atomic_int_set(&ct->running, 0);
+  // The blocking read() returns in about a device period.
+  g_thread_join(ct->thread);
+
+  if(ct->overruns)
+    QS_SPEW("capture thread had %d over-runs\n", ct->overruns);
+
+#ifdef QS_DEBUG
+  memset(ct->buf, 0, sizeof(float)*ct->len);
+#endif
+  g_free(ct->buf);
+#ifdef QS_DEBUG
+  memset(ct, 0, sizeof(*ct));
+#endif
+  g_free(ct);
+}
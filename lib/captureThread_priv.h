@@ -0,0 +1,101 @@
+/* Quickscope - a software oscilloscope
+ * Copyright (C) 2012-2014  Lance Arsenault
+ * GNU General Public License version 3
+ */
+
+// A capture thread does the blocking device reads (like snd_pcm_readi())
+// in its own thread, so that a slow drawing main loop does not stall
+// the capture device and cause device buffer over-runs.
+//
+// The capture thread is the one and only producer and the source read
+// callback, in the main loop, is the one and only consumer of a ring
+// buffer of float values, so we need no locks.  The producer is the
+// only writer of writeIndex and the consumer is the only writer of
+// readIndex.  The indexes are free running counters that are masked
+// with (len - 1) to get the array index, so they can wrap through
+// UINT_MAX without a problem.
+//
+// We keep the QsSource ring buffers (framePtr and group time) owned
+// by the main loop thread, because iterators and the master/slave
+// source ring buffer checks read and reset them without any locking.
+
+struct QsCaptureThread
+{
+  GThread *thread;
+
+  // The blocking read function that is called in the capture thread.
+  // Returns the number of values read or less than zero on error.
+  int (*read)(void *data, float *buf, int n);
+  void *data;
+
+  float *buf;
+  guint len; // length of buf, a power of 2
+  int chunk; // max number of values we ask read() for
+
+  // Only access these with g_atomic_int_get() and g_atomic_int_set()
+  volatile gint writeIndex, readIndex;
+  volatile gint running; // thread keeps running if set
+  volatile gint failed; // read() failed if set
+  volatile gint overruns; // number of times the consumer was too slow
+};
+
+
+extern
+struct QsCaptureThread *_qsCaptureThread_create(
+    int (*read)(void *data, float *buf, int n), void *data,
+    int chunk, int len);
+
+extern
+void _qsCaptureThread_destroy(struct QsCaptureThread *ct);
+
+// Number of values that may be read by the consumer
+static inline
+int _qsCaptureThread_available(struct QsCaptureThread *ct)
+{
+  QS_ASSERT(ct);
+  return (guint) g_atomic_int_get(&ct->writeIndex) -
+    (guint) ct->readIndex;
+}
+
+// Read up to n values into buf in the consumer thread.
+// Returns the number of values read, or -1 if the capture
+// thread failed.
+static inline
+int _qsCaptureThread_read(struct QsCaptureThread *ct, float *buf, int n)
+{
+  QS_ASSERT(ct);
+  QS_ASSERT(n >= 0);
+
+  if(g_atomic_int_get(&ct->failed))
+    return -1;
+
+  guint r, avail, mask;
+  r = ct->readIndex;
+  // g_atomic_int_get() is a memory barrier so the values in ct->buf
+  // are written before we see the new writeIndex.
+  avail = (guint) g_atomic_int_get(&ct->writeIndex) - r;
+  if((guint) n > avail)
+    n = avail;
+
+  mask = ct->len - 1;
+  int i;
+  for(i = 0; i < n; ++i)
+    buf[i] = ct->buf[(r + i) & mask];
+
+  // Publish that we are done with these values.
+  g_atomic_int_set(&ct->readIndex, (gint) (r + n));
+  return n;
+}
+
+// Drop the oldest values in the consumer thread, leaving keep values
+// that are left to read.
+static inline
+void _qsCaptureThread_skip(struct QsCaptureThread *ct, int keep)
+{
+  QS_ASSERT(ct);
+  int avail;
+  avail = _qsCaptureThread_available(ct);
+  if(avail > keep)
+    g_atomic_int_set(&ct->readIndex,
+        (gint) ((guint) ct->readIndex + (avail - keep)));
+}
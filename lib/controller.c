@@ -71,6 +71,10 @@ bool _qsController_run(struct QsController *c)
   QS_ASSERT(c);
 
   t = _qsTimer_get(qsApp->timer);
+
+  // So the render threads are not reading the source buffers while
+  // we write them.
+  _qsSource_lock();
   
   /* we will go through the list of QsSources */
   for(l=c->sources; l; l=l->next)
@@ -108,6 +112,8 @@ bool _qsController_run(struct QsController *c)
       c->changedSource(c, c->sources);
   }
 
+  _qsSource_unlock();
+
   return true;
 }
 
@@ -0,0 +1,181 @@
+/* Quickscope - a software oscilloscope
+ * Copyright (C) 2012-2014  Lance Arsenault
+ * GNU General Public License version 3
+ */
+
+// QsInterpolate is a source that copies a channel of a source from a
+// different source group into this group, by linearly interpolating
+// its values to the time stamps of this group with a QsIteratorX.
+// Then sweeps and traces in this group can use it, like for
+// triggering a sweep of a sound card capture on a slower data feed.
+
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <gtk/gtk.h>
+#include "debug.h"
+#include "Assert.h"
+#include "base.h"
+#include "app.h"
+#include "adjuster.h"
+#include "group.h"
+#include "source.h"
+#include "iterator.h"
+#include "rungeKutta.h"
+#include "sourceParticular.h"
+
+static int createCount = 0;
+
+
+struct QsInterpolate
+{
+  // inherit QsSource
+  struct QsSource source;
+  struct QsSource *sourceIn, // The source we read from the other group
+    *timeSource; // The source in this group that we get the time
+    // stamps from.
+  struct QsIteratorX *it;
+  float maxLatency;
+  int id; // this interpolate createCount
+  int sourceInID, timeSourceID;
+};
+
+
+static
+int cb_interpolate(struct QsInterpolate *ip)
+{
+  struct QsSource *s;
+  float x0, x1, *val;
+  long double t, *tOut = NULL;
+
+  s = (struct QsSource *) ip;
+
+  // The latency may change from the adjuster.
+  ip->it->maxLatency = ip->maxLatency;
+
+  while(qsIteratorX_get(ip->it, &x0, &x1, &t))
+  {
+    val = qsSource_setFrame(s, &tOut);
+    // Catch up to the time source with pen lifts if the iterator
+    // got reset ahead of us.
+    while(*tOut < t)
+    {
+      *val = QS_LIFT;
+      val = qsSource_setFrame(s, &tOut);
+    }
+    QS_VASSERT(*tOut == t, "*tOut=%Lg  t=%Lg\n", *tOut, t);
+    *val = x1;
+  }
+
+  return (tOut)?1:0;
+}
+
+static
+size_t iconText(char *buf, size_t len, struct QsInterpolate *ip)
+{
+  return snprintf(buf, len,
+      "<span bgcolor=\"#86C5FF\" fgcolor=\"#C81F97\">["
+      "<span fgcolor=\"#3F3A21\">interp%d</span>"
+      "]</span> ", ip->id);
+}
+
+static inline
+bool sourceIsValid(struct QsSource *s, int id)
+{
+  GSList *l;
+  // It could be a different source at the same address, but not if
+  // it has the same source ID.
+  l = g_slist_find(qsApp->sources, s);
+  return (l && s->id == id);
+}
+
+static void
+_qsInterpolate_destroy(struct QsSource *s)
+{
+  QS_ASSERT(s);
+  struct QsInterpolate *ip;
+  ip = (struct QsInterpolate *) s;
+
+  // All the automatic managed source destruction happens in the
+  // reverse order of the creation, so the sources we read should
+  // still be around, but we check anyway.  If one is gone it
+  // destroyed its iterator already.
+  if(sourceIsValid(ip->sourceIn, ip->sourceInID) &&
+      sourceIsValid(ip->timeSource, ip->timeSourceID))
+    qsIteratorX_destroy(ip->it);
+  else
+  {
+    if(sourceIsValid(ip->sourceIn, ip->sourceInID))
+      qsIterator_destroy(ip->it->it1);
+    if(sourceIsValid(ip->timeSource, ip->timeSourceID))
+      qsIterator_destroy(ip->it->it0);
+    g_free(ip->it);
+  }
+  ip->it = NULL;
+}
+
+struct QsSource *qsInterpolate_create(struct QsSource *sourceIn,
+    int channelNum, float maxLatency, struct QsSource *group)
+{
+  QS_ASSERT(sourceIn);
+  QS_ASSERT(group);
+  QS_ASSERT(group->group);
+  QS_ASSERT(sourceIn->group != group->group);
+  QS_ASSERT(channelNum >= 0 && channelNum < sourceIn->numChannels);
+  QS_ASSERT(maxLatency >= 0.0F);
+
+  struct QsInterpolate *ip;
+
+  ip = qsSource_create(
+      (QsSource_ReadFunc_t) cb_interpolate,
+      1 /*numChannels*/,
+      0 /*maxNumFrames*/,
+      group /*source group*/,
+      sizeof(*ip));
+
+  // We get the time stamps from the group master, which has one
+  // value per frame.
+  ip->timeSource = group->group->master;
+  ip->timeSourceID = ip->timeSource->id;
+  ip->sourceIn = sourceIn;
+  ip->sourceInID = sourceIn->id;
+  ip->maxLatency = maxLatency;
+  ip->id = createCount++;
+  ip->it = qsIteratorX_create(ip->timeSource, sourceIn,
+      0, channelNum, maxLatency);
+  qsSource_initIterator((struct QsSource *) ip, ip->it->it0);
+
+  // We don't care what the frame sample rate is, it's set by the
+  // group master.
+  const float minMaxSampleRates[] = { 0.01F , 2*44100.0F };
+  qsSource_setFrameRateType((struct QsSource *) ip, QS_TOLERANT,
+      minMaxSampleRates, 1.0F);
+
+  qsSource_setScale((struct QsSource *) ip, sourceIn->scale[channelNum]);
+  qsSource_setShift((struct QsSource *) ip, sourceIn->shift[channelNum]);
+  if(sourceIn->units && sourceIn->units[channelNum])
+    qsSource_setUnit((struct QsSource *) ip, sourceIn->units[channelNum]);
+
+  struct QsAdjuster *adjG;
+  struct QsAdjusterList *adjL;
+  adjL = (struct QsAdjusterList *) ip;
+
+  adjG = qsAdjusterGroup_start(adjL, "Interpolate");
+  qsAdjuster_setIconStrFunc(adjG,
+      (size_t (*)(char *, size_t, void *)) iconText, ip);
+  qsAdjuster_setIconStrFunc(
+      /* How long we wait for sourceIn to get values
+       * to interpolate between, before we just use
+       * the last value. */
+      qsAdjusterFloat_create(adjL,
+      "Max Latency", "sec", &ip->maxLatency,
+      0.0F, /* min */ 100.0F, /* max */
+      NULL, NULL),
+      (size_t (*)(char *, size_t, void *)) iconText, ip);
+  qsAdjusterGroup_end(adjG);
+
+  qsSource_addSubDestroy(ip, _qsInterpolate_destroy);
+
+  return (struct QsSource *) ip;
+}
@@ -38,12 +38,18 @@ struct QsIterator
   it->source = s;
   it->channel = channel;
   
+  // The source may be written, and its iterator list walked, by
+  // another thread.
+  _qsSource_lock();
+
   // initialize to having no data to read and
   // will read the next point written.
   qsIterator_reInit(it);
 
   s->iterators = g_slist_prepend(s->iterators, it);
 
+  _qsSource_unlock();
+
 #ifdef QS_DEBUG
   it->lastT = -INFINITY;
 #endif
@@ -66,8 +72,10 @@ void qsIterator_destroy(struct QsIterator *it)
 {
   QS_ASSERT(it);
   QS_ASSERT(it->source);
+  _qsSource_lock();
   QS_ASSERT(g_slist_find(it->source->iterators, it));
   it->source->iterators = g_slist_remove(it->source->iterators, it);
+  _qsSource_unlock();
 #ifdef QS_DEBUG
   memset(it, 0, sizeof(*it));
 #endif
@@ -96,6 +104,8 @@ struct QsIterator2
   it->channel0 = channel0;
   it->channel1 = channel1;
  
+  _qsSource_lock();
+
   // initialize to having no data to read
   qsIterator2_reInit(it);
  
@@ -103,6 +113,8 @@ struct QsIterator2
   if(s0 != s1)
     s1->iterator2s = g_slist_prepend(s1->iterator2s, it);
 
+  _qsSource_unlock();
+
 #ifdef QS_DEBUG
   it->lastT = -INFINITY;
 #endif
@@ -119,6 +131,7 @@ void qsIterator2_destroy(struct QsIterator2 *it)
   QS_ASSERT(s0);
   QS_ASSERT(s1);
   
+  _qsSource_lock();
   QS_ASSERT(g_slist_find(s0->iterator2s, it));
   s0->iterator2s = g_slist_remove(s0->iterator2s, it);
   if(s0 != s1)
@@ -126,7 +139,130 @@ void qsIterator2_destroy(struct QsIterator2 *it)
     QS_ASSERT(g_slist_find(s1->iterator2s, it));
     s1->iterator2s = g_slist_remove(s1->iterator2s, it);
   }
+  _qsSource_unlock();
+
+#ifdef QS_DEBUG
+  memset(it, 0, sizeof(*it));
+#endif
+  g_free(it);
+}
+
+static inline
+long double frameTime(const struct QsSource *s, int i)
+{
+  return s->group->time[s->timeIndex[i]];
+}
+
+// Returns the first frame index in [lo, hi] with a time at or after
+// t, or hi + 1 if there is none.  The frame times are in order in
+// [lo, hi].
+static inline
+int lowerBound(const struct QsSource *s, int lo, int hi, long double t)
+{
+  ++hi;
+  while(lo < hi)
+  {
+    int mid;
+    mid = lo + (hi - lo)/2;
+    if(frameTime(s, mid) < t)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
 
+bool qsIterator_seekTime(struct QsIterator *it, long double t,
+    float *x, long double *tOut, long double *tPrev)
+{
+  QS_ASSERT(it);
+  QS_ASSERT(x);
+  QS_ASSERT(tOut);
+
+  struct QsSource *s;
+  int i, startI;
+  int startWrapCount;
+  bool ret = true;
+
+  if(!qsIterator_check(it))
+    return false; // no data to read.
+
+  s = it->source;
+  startI = i = it->i + 1;
+  startWrapCount = it->wrapCount;
+
+  if(s->wrapCount != it->wrapCount)
+  {
+    // The values to read are split by the ring buffer wrap, from
+    // it->i + 1 to iMax in the older lap and then from 0 to s->i.
+    QS_ASSERT(s->wrapCount - it->wrapCount == 1);
+    i = lowerBound(s, i, s->iMax, t);
+    if(i > s->iMax)
+    {
+      ++it->wrapCount;
+      i = 0;
+    }
+  }
+
+  if(s->wrapCount == it->wrapCount)
+  {
+    i = lowerBound(s, i, s->i, t);
+    if(i > s->i)
+    {
+      // They are all before t, so we read them all.
+      i = s->i;
+      ret = false;
+    }
+  }
+
+  if(tPrev)
+  {
+    // The value before i, if we skipped over it.
+    if(i > 0 && (it->wrapCount != startWrapCount || i - 1 >= startI))
+      *tPrev = frameTime(s, i - 1);
+    else if(i == 0 && it->wrapCount != startWrapCount && s->iMax >= startI)
+      *tPrev = frameTime(s, s->iMax);
+  }
+
+  it->i = i;
+  *x = s->framePtr[i * s->numChannels + it->channel];
+  *tOut = frameTime(s, i);
+
+#ifdef QS_DEBUG
+  QS_VASSERT(*tOut >= it->lastT, "Time is decreasing:\n"
+      "Time went from (it->lastT=) %Lg to (*tOut=) %Lg",
+      it->lastT, *tOut);
+  it->lastT = *tOut;
+#endif
+
+  return ret;
+}
+
+struct QsIteratorX
+*qsIteratorX_create(struct QsSource *s0, struct QsSource *s1,
+    int channel0, int channel1, float maxLatency)
+{
+  QS_ASSERT(s0);
+  QS_ASSERT(s1);
+  QS_ASSERT(maxLatency >= 0.0F);
+
+  struct QsIteratorX *it;
+
+  it = g_malloc0(sizeof(*it));
+  // The two iterators are owned by the sources like any other
+  // iterators, so the sources must not be destroyed before this.
+  it->it0 = qsIterator_create(s0, channel0);
+  it->it1 = qsIterator_create(s1, channel1);
+  it->maxLatency = maxLatency;
+
+  return it;
+}
+
+void qsIteratorX_destroy(struct QsIteratorX *it)
+{
+  QS_ASSERT(it);
+  qsIterator_destroy(it->it0);
+  qsIterator_destroy(it->it1);
 #ifdef QS_DEBUG
   memset(it, 0, sizeof(*it));
 #endif
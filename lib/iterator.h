@@ -33,6 +33,53 @@ struct QsIterator2
 #endif
 };
 
+// Reads value pairs from two sources that may be in different source
+// groups, so they may have different time stamps.  The values of
+// source1 are linearly interpolated to the time stamps of source0, so
+// make source0 the faster source.  A source0 value waits until
+// source1 has a value at or after its time, or until it is
+// maxLatency seconds older than the newest source0 time stamp, and
+// then we use the last source1 value.
+struct QsIteratorX
+{
+  struct QsIterator *it0, *it1;
+  float maxLatency;
+
+  // The source0 value waiting for source1.
+  float x0;
+  long double t0;
+  // The last two source1 values read, a before b.
+  float xa, xb;
+  long double ta, tb;
+  bool haveX0, haveA, haveB,
+       lift; // read a source1 QS_LIFT since the last value pair
+};
+
+// A contiguous run of value pairs read with qsIterator2_getSpan().
+// The values are x0[k*stride0], x1[k*stride1] and t[k]
+// for k = 0, 1, 2, ..., len - 1
+// These point into the source ring buffers, so they are only valid
+// until the sources are written to again.
+struct QsIterator2Span
+{
+  const float *x0, *x1;
+  const long double *t;
+  int stride0, stride1, len;
+};
+
+// A contiguous run of values that qsIterator_peekSpan() found next to
+// read.  The values are x[k*stride] with time time[timeIndex[k]]
+// for k = 0, 1, 2, ..., len - 1
+// These point into the source ring buffer, so they are only valid
+// until the source is written to again.
+struct QsIteratorSpan
+{
+  const float *x;
+  const int *timeIndex;
+  const long double *time;
+  int stride, len;
+};
+
 
 extern
 struct QsIterator
@@ -47,6 +94,20 @@ struct QsIterator
 extern
 void qsIterator_destroy(struct QsIterator *it);
 
+// Reads values like qsIterator_get() until it gets the first value
+// with time at or after t, but with a binary search of the source
+// ring buffer, since the time stamps are in order.  Returns true with
+// that value in x and tOut.  Returns false if there are no values to
+// read, or if all the values are before t, and then x and tOut are
+// the last value written and the iterator has read everything.  If
+// tPrev is not NULL and the seek skipped over any values, tPrev is set
+// to the time of the value just before the one returned, like the
+// last time that a qsIterator_get() loop would have read; else tPrev
+// is not changed.
+extern
+bool qsIterator_seekTime(struct QsIterator *it, long double t,
+    float *x, long double *tOut, long double *tPrev);
+
 extern
 struct QsIterator2
 *qsIterator2_create(struct QsSource *s0, struct QsSource *s1,
@@ -55,6 +116,14 @@ struct QsIterator2
 extern
 void qsIterator2_destroy(struct QsIterator2 *it);
 
+extern
+struct QsIteratorX
+*qsIteratorX_create(struct QsSource *s0, struct QsSource *s1,
+    int channel0, int channel1, float maxLatency);
+
+extern
+void qsIteratorX_destroy(struct QsIteratorX *it);
+
 static inline
 void qsIterator_copy(struct QsIterator *it,
     const struct QsIterator *from)
@@ -645,6 +714,222 @@ PRINT();
   return true;
 }
 
+// Look at up to maxLen of the next values to read without reading
+// them, so that the caller can loop through a block of values without
+// the per value checks in qsIterator_get().  Use qsIterator_skip() to
+// read them.  Returns the number of values in the span, span->len,
+// which is 0 if there are no values to read.  A span ends at a ring
+// buffer wrap, or at maxLen.
+static inline
+int qsIterator_peekSpan(struct QsIterator *it,
+    struct QsIteratorSpan *span, int maxLen)
+{
+  QS_ASSERT(span);
+  QS_ASSERT(maxLen > 0);
+
+  if(!qsIterator_check(it))
+    return (span->len = 0); // no data to read.
+
+  struct QsSource *s;
+  int i, end;
+  s = it->source;
+  i = it->i + 1;
+
+  if(s->wrapCount != it->wrapCount && i > s->iMax)
+  {
+    i = 0;
+    end = s->i;
+  }
+  else if(s->wrapCount != it->wrapCount)
+    end = s->iMax;
+  else
+    end = s->i;
+
+  span->len = end - i + 1;
+  if(span->len > maxLen)
+    span->len = maxLen;
+  QS_ASSERT(span->len > 0);
+
+  span->x = &s->framePtr[i * s->numChannels + it->channel];
+  span->stride = s->numChannels;
+  span->timeIndex = &s->timeIndex[i];
+  span->time = s->group->time;
+
+  return span->len;
+}
+
+// Read the first n values of the span from the last
+// qsIterator_peekSpan(), without looking at them.
+static inline
+void qsIterator_skip(struct QsIterator *it, int n)
+{
+  QS_ASSERT(it);
+  QS_ASSERT(n > 0);
+
+  struct QsSource *s;
+  s = it->source;
+
+  it->i += n;
+  if(s->wrapCount != it->wrapCount && it->i > s->iMax)
+  {
+    // The span started at the wrap.
+    it->i -= s->iMax + 1;
+    ++it->wrapCount;
+  }
+  QS_ASSERT(it->i >= 0 && it->i <= s->iMax);
+
+#ifdef QS_DEBUG
+  it->lastT = s->group->time[s->timeIndex[it->i]];
+#endif
+}
+
+// Read 2 particular sources and channels in a span of up to maxLen
+// value pairs, so that the caller can loop through a block of values
+// without the per value checks in qsIterator2_get().
+// Returns the number of value pairs in the span, span->len, which
+// is 0 if there are no values to read.  A span ends at a ring buffer
+// wrap, at a frame with more than one value, or at maxLen.
+static inline
+int qsIterator2_getSpan(struct QsIterator2 *it,
+    struct QsIterator2Span *span, int maxLen)
+{
+  QS_ASSERT(it);
+  QS_ASSERT(span);
+  QS_ASSERT(maxLen > 0);
+
+  float x0, x1;
+  long double t;
+
+  // We let qsIterator2_get() do all the hard work of
+  // getting the first pair, and we just extend from there.
+  if(!qsIterator2_get(it, &x0, &x1, &t))
+    return (span->len = 0);
+
+  struct QsSource *s0, *s1;
+  s0 = it->source0;
+  s1 = it->source1;
+
+  int i0, i1, n, end0, end1;
+  i0 = it->i0;
+  i1 = it->i1;
+
+  // The last index that we may read in each source
+  // without a wrap to index 0.
+  end0 = (s0->wrapCount != it->wrapCount)? s0->iMax: s0->i;
+  end1 = (s1->wrapCount != it->wrapCount)? s1->iMax: s1->i;
+
+  n = maxLen - 1;
+  if(n > end0 - i0)
+    n = end0 - i0;
+  if(n > end1 - i1)
+    n = end1 - i1;
+  if(n < 0)
+    n = 0;
+
+  if(!s0->isMaster || !s1->isMaster)
+  {
+    // Non-master sources may have frames with more than one
+    // value in them, so we stop at the first time index that
+    // does not increase by one.  The master source time index
+    // is always the same as its frame index.
+    const int *tI0, *tI1;
+    tI0 = &s0->timeIndex[i0];
+    tI1 = &s1->timeIndex[i1];
+    int k;
+    for(k = 0; k < n; ++k)
+      if(tI0[k+1] != tI0[k] + 1 || tI1[k+1] != tI1[k] + 1)
+        break;
+    n = k;
+  }
+
+  span->x0 = &s0->framePtr[i0 * s0->numChannels + it->channel0];
+  span->x1 = &s1->framePtr[i1 * s1->numChannels + it->channel1];
+  span->stride0 = s0->numChannels;
+  span->stride1 = s1->numChannels;
+  span->t = &s0->group->time[s0->timeIndex[i0]];
+  span->len = n + 1;
+
+  it->i0 = i0 + n;
+  it->i1 = i1 + n;
+
+#ifdef QS_DEBUG
+  QS_ASSERT(s0->timeIndex[it->i0] == s1->timeIndex[it->i1]);
+  it->lastT = span->t[n];
+#endif
+
+  return span->len;
+}
+
+// Read a source0 value and the source1 value interpolated to its time.
+// Returns true if there is a value pair, else returns false if there
+// is no value pair, yet.  x1 is QS_LIFT if there are no source1
+// values from before t, or if source1 lifted the pen since the last
+// pair, since we can't interpolate across a pen lift.
+static inline
+bool qsIteratorX_get(struct QsIteratorX *it,
+    float *x0, float *x1, long double *t)
+{
+  QS_ASSERT(it);
+
+  if(!it->haveX0)
+  {
+    if(!qsIterator_get(it->it0, &it->x0, &it->t0))
+      return false;
+    it->haveX0 = true;
+  }
+
+  // Read source1 until we have a value at or after t0.
+  while(!it->haveB || it->tb < it->t0)
+  {
+    float x;
+    long double tx;
+    if(!qsIterator_get(it->it1, &x, &tx))
+      break;
+    if(isnan(x))
+      // Remember it, even if we read past it before the next t0.
+      it->lift = true;
+    it->xa = it->xb;
+    it->ta = it->tb;
+    it->haveA = it->haveB;
+    it->xb = x;
+    it->tb = tx;
+    it->haveB = true;
+  }
+
+  if(it->haveB && it->tb >= it->t0)
+  {
+    if(!it->haveA || it->ta > it->t0)
+      // source1 starts after t0.
+      *x1 = QS_LIFT;
+    else if(it->tb == it->t0)
+      *x1 = it->xb;
+    else if(it->lift || isnan(it->xa))
+      // The pen is lifted in between.
+      *x1 = QS_LIFT;
+    else if(it->tb == it->ta)
+      *x1 = it->xb;
+    else
+      *x1 = it->xa + (it->xb - it->xa)*
+        (float) ((it->t0 - it->ta)/(it->tb - it->ta));
+  }
+  else
+  {
+    // source1 does not have a value at t0 yet.
+    struct QsSource *master;
+    master = it->it0->source->group->master;
+    if(master->group->time[master->i] - it->t0 < it->maxLatency)
+      return false; // we wait for it
+    // We waited long enough.
+    *x1 = (it->haveB && !it->lift)?it->xb:QS_LIFT;
+  }
+
+  *x0 = it->x0;
+  *t = it->t0;
+  it->haveX0 = false;
+  it->lift = false;
+  return true;
+}
+
 // Sets frame at index based on an iterator which was read with
 // call again with the same iterator to write more than one value
 // in the given frame, from a call to qsIterator_get(it,...).
@@ -48,6 +48,25 @@ struct ChangeCallback
 QS_BASE_DEFINE(qsSource, struct QsSource)
 
 
+// The render threads (op_renderThread) read the source ring buffers
+// through their trace iterators while the main thread writes them in
+// the source reads, so they both hold this while they do.  It's
+// recursive because a source read can destroy sources and traces,
+// which lock it too.  A GRecMutex that is static does not need to be
+// initialized.
+static GRecMutex sourceLock;
+
+void _qsSource_lock(void)
+{
+  g_rec_mutex_lock(&sourceLock);
+}
+
+void _qsSource_unlock(void)
+{
+  g_rec_mutex_unlock(&sourceLock);
+}
+
+
 void *qsSource_addChangeCallback(struct QsSource *s,
     bool (*callback)(struct QsSource *, void *), void *data)
 {
@@ -186,6 +205,8 @@ void qsSource_destroy(struct QsSource *s)
   QS_ASSERT(g->master);
   QS_SPEW("source->id=%d\n", s->id);
 
+  _qsSource_lock();
+
   // set rate type change flag
   g->sourceTypeChange = true;
 
@@ -218,6 +239,8 @@ void qsSource_destroy(struct QsSource *s)
    * if it's not being destroyed now. */
   _qsSource_internalDestroy(s, g);
 
+  _qsSource_unlock();
+
   _qsApp_checkDestroy();
 }
 
@@ -573,8 +596,15 @@ int _qsSource_read(struct QsSource *s, long double time)
     }
     for(l = s->traces;l;l=l->next)
     {
-      QS_ASSERT(l->data);
-      _qsTrace_draw((struct QsTrace *)l->data, time);
+      struct QsTrace *trace;
+      trace = l->data;
+      QS_ASSERT(trace);
+      if(trace->win->render)
+        // The window's render thread will draw it when it gets
+        // to it.
+        _qsWin_renderPublish(trace->win);
+      else
+        _qsTrace_draw(trace, time);
     }
 
     // The prevT is the previous time that we got data,
@@ -594,7 +624,11 @@ int _qsSource_read(struct QsSource *s, long double time)
       QS_ASSERT(l->data);
       // This is an inline function that will handle being called
       // more than once, and when it's not really needed.
-      _qsWin_postTraceDraw(((struct QsTrace *) l->data)->win, time);
+      struct QsWin *win;
+      win = ((struct QsTrace *) l->data)->win;
+      if(!win->render)
+        // A render thread does its own fade drawing.
+        _qsWin_postTraceDraw(win, time);
     }
   }
   else // if(ret == -1)
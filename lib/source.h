@@ -259,10 +259,11 @@ void qsSource_setIsSwipable(struct QsSource *s, bool isSwipable)
   s->isSwipable = isSwipable;
 }
 
-// TODO: make plotting (traces) between 2 sources in different groups
-// by interpolating with the time stamps of the two different source
-// groups.  Currently we only support traces with 2 sources from the
-// same group which means that the 2 sources use the same time stamps.
+// Traces and sweeps only work with sources from the same group, which
+// means that the sources use the same time stamps.  To use a source
+// from another group make a qsInterpolate_create() source in this
+// group, which interpolates with the time stamps of the two different
+// source groups using a QsIteratorX.
 
 extern
 void qsSource_destroy(struct QsSource *source);
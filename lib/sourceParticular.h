@@ -83,6 +83,63 @@ struct QsSource *qsSweep_create(
     float period, float level, int slope, float holdOff,
     float delay, struct QsSource *sourceIn, int channelNum);
 
+/* Sweep trigger modes.  The sweep slope picks the polarity, so with
+ * slope > 0 it's a positive pulse, entering the window, or a positive
+ * runt, and the other way with slope < 0.  slope = 0 is free run in
+ * all modes. */
+enum QsSweepTrigger
+{
+  QS_TRIGGER_EDGE = 0, /* the trace crosses level, the default */
+  QS_TRIGGER_PULSE_LESS, /* a pulse past level shorter than width */
+  QS_TRIGGER_PULSE_MORE, /* a pulse past level longer than width */
+  QS_TRIGGER_WINDOW, /* enters (slope > 0) or leaves (slope < 0)
+                        the band between level and level2 */
+  QS_TRIGGER_RUNT, /* a pulse past level that does not get to level2,
+                      so level2 must be past level in the slope
+                      direction, else every pulse gets to it */
+  QS_TRIGGER_NTH_EDGE /* the count-th edge after the sweep is armed */
+};
+
+extern
+void qsSweep_setTrigger(struct QsSource *sweep,
+    enum QsSweepTrigger trigger, float level2, float width, int count);
+
+/* Segmented (fast frame) capture.  The sweep input values from each
+ * trigger (plus delay) for segmentPeriod seconds are copied into the
+ * next of numSegments segments, with the trigger time.  The segments
+ * have their own trigger, with the same trigger settings as the
+ * sweep, that re-arms as soon as a segment is full with no hold off,
+ * so that bursts of triggers closer than the sweep period are kept
+ * and not just the last sweep drawn.  segmentPeriod = 0, or more
+ * than the sweep period, is the sweep period.  numSegments = 0 turns
+ * it off. */
+extern
+void qsSweep_setSegments(struct QsSource *sweep, int numSegments,
+    float segmentPeriod);
+/* Gets the n-th newest segment, n = 0 for the last one captured.
+ * data is set to the (sweep position, value) pairs.  Returns the
+ * number of pairs, or 0 if there is no such segment.  The data is
+ * good until the next sweep source read. */
+extern
+int qsSweep_getSegment(struct QsSource *sweep, int n,
+    const float **data, long double *triggerT);
+/* Makes a 2 channel source, sweep position and value, that plays back
+ * the segments, so you can trace channel 0 against channel 1 to
+ * overlay them all or step through them with the "Show Segment"
+ * adjuster. */
+extern
+struct QsSource *qsSweep_createSegmentSource(struct QsSource *sweep);
+
+/* Makes a source in the group of source group that has the values of
+ * channel channelNum of sourceIn, which is in a different group,
+ * linearly interpolated to the time stamps of group.  Use it to
+ * trigger a sweep, or draw a trace, with sources from two groups.
+ * The values lag by up to maxLatency seconds when sourceIn is slow
+ * to write. */
+extern
+struct QsSource *qsInterpolate_create(struct QsSource *sourceIn,
+    int channelNum, float maxLatency, struct QsSource *group);
+
 static inline
 void qsRK4Source_setODEData(struct QsRK4Source *rk4s, void *data)
 {
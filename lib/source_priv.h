@@ -14,3 +14,10 @@ extern
 int _qsSource_read(struct QsSource *source, long double time);
 extern
 bool _qsSource_checkTypes(struct QsSource *s);
+
+/* Hold this to read or write the source ring buffers, or to change
+ * the source iterator lists, when there may be render threads. */
+extern
+void _qsSource_lock(void);
+extern
+void _qsSource_unlock(void);
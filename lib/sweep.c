@@ -7,6 +7,9 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <gtk/gtk.h>
+#if defined(__SSE__)
+#  include <xmmintrin.h>
+#endif
 #include "debug.h"
 #include "Assert.h"
 #include "base.h"
@@ -18,6 +21,10 @@
 #include "sourceParticular.h"
 #include "iterator.h"
 
+// The most trigger source values that we look at at a time
+// when looking for a trigger edge.
+#define SPAN_LEN  1024
+
 // TODO: clearly this is not thread safe
 static int createCount = 0;
 
@@ -28,6 +35,21 @@ static int createCount = 0;
 enum STATE { HELD, ARMED, TRIGGERED, RUN, POSTRUN };
 
 
+// A segment of a segmented capture, see qsSweep_setSegments().
+struct QsSweepSegment
+{
+  long double triggerT;
+  int len; // number of (sweep position, value) pairs
+};
+
+// The trigger mode state while armed.  It's reset when we arm.
+struct QsSweepTrigState
+{
+  int phase; // in a pulse or runt, or 2 for a runt that is not
+  int edgeCount; // edges since we armed
+  long double pulseT; // when the pulse started
+};
+
 struct QsSweep
 {
   // inherit QsSource
@@ -42,6 +64,31 @@ struct QsSweep
   float period, holdOff, oldHoldOff, delay, newDelay,
         level, prevValueRead, prevValueOut;
   int slope, oldSlope; /* +1 or 0 for free run or -1 */
+
+  // The trigger mode, enum QsSweepTrigger, and its parameters.
+  int trigger;
+  float level2, width;
+  int count;
+  struct QsSweepTrigState trig; // for the sweep we draw
+
+  // Segmented capture.  Segment number n, counting from 0 as they are
+  // captured, is in segments[n % numSegments], and its values are at
+  // segmentData[2*segmentLen*(n % numSegments)].  segments is NULL
+  // if we are not doing segmented capture.
+  struct QsSweepSegment *segments;
+  float *segmentData;
+  int numSegments, segmentLen;
+  int segmentsDone; // number of segments captured
+  bool segmentOpen; // we are writing segment segmentsDone
+  // The segments have their own trigger, apart from the sweep that
+  // we draw, reading sourceIn with segIt.  segBackIt is where we
+  // re-armed, for a negative delay.
+  struct QsIterator *segIt, *segBackIt;
+  struct QsSweepTrigState segTrig;
+  float segmentPeriod; // 0 for the sweep period
+  float segPrevY; // the last value segIt read
+  long double segPrevT, segStartT,
+    segTrigValueT; // time of the value that made the last trigger
   int id; // this sweep createCount
   int sourceInID;
   enum STATE state; // sweep state when not free run
@@ -60,6 +107,348 @@ float _qsSweep_val(long double t, long double startT,
   return (float) fmodl(t - startT, period)/period - 0.5F;
 }
 
+// Returns true if the trigger source going from value prev to y
+// crosses level with the slope.
+static inline
+bool isEdge(float prev, float y, float level, int slope)
+{
+  if(slope > 0)
+    return (prev <= level && level <= y && prev < y);
+  return (prev >= level && level >= y && prev > y);
+}
+
+// The time that the line from (prevT, prev) to (t, y) crosses level.
+static inline
+long double crossT(float prev, long double prevT, float y, long double t,
+    float level)
+{
+  return prevT + (level - prev)*(t - prevT)/(y - prev);
+}
+
+// Returns the index of the first value in x[k*stride] for k = 0, 1,
+// ..., n - 1 that makes an edge with the value before it, where the
+// value before x[0] is prev.  Returns n if there is no edge.
+static inline
+int findEdge(const float *x, int stride, int n,
+    float prev, float level, int slope)
+{
+  int k = 1;
+
+  if(isEdge(prev, x[0], level, slope))
+    return 0;
+
+#if defined(__SSE__)
+  if(stride == 1)
+  {
+    // Compare 4 values at a time with the 4 values before them.  The
+    // trigger may be very rare so this is where the sweep spends its
+    // time.
+    const __m128 L = _mm_set1_ps(level);
+    for(; k + 4 <= n; k += 4)
+    {
+      __m128 Y, P, m;
+      Y = _mm_loadu_ps(&x[k]);
+      P = _mm_loadu_ps(&x[k-1]);
+      if(slope > 0)
+        m = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(P, L), _mm_cmple_ps(L, Y)),
+            _mm_cmplt_ps(P, Y));
+      else
+        m = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(P, L), _mm_cmpge_ps(L, Y)),
+            _mm_cmpgt_ps(P, Y));
+      int bits;
+      bits = _mm_movemask_ps(m);
+      if(bits)
+        return k + __builtin_ctz(bits);
+    }
+  }
+#endif
+
+  for(; k < n; ++k)
+    if(isEdge(x[(k-1)*stride], x[k*stride], level, slope))
+      return k;
+
+  return n;
+}
+
+// Trigger modes other than QS_TRIGGER_EDGE.  Steps the trigger mode
+// state with the trigger source value y at time t, where the value
+// before it was prev at time prevT.  Returns true if it triggers, and
+// sets cross to the level that we interpolate the trigger time at.
+static inline
+bool triggerStep(struct QsSweep *sw, struct QsSweepTrigState *ts,
+    float prev, long double prevT, float y, long double t, float *cross)
+{
+  int slope;
+  float level;
+  slope = sw->slope;
+  level = sw->level;
+
+  if(isinf(prev))
+    // It's the first value after we armed.
+    return false;
+
+  switch(sw->trigger)
+  {
+    case QS_TRIGGER_PULSE_LESS:
+    case QS_TRIGGER_PULSE_MORE:
+    {
+      long double width;
+
+      if(!ts->phase)
+      {
+        if(isEdge(prev, y, level, slope))
+        {
+          // The pulse starts.
+          ts->phase = 1;
+          ts->pulseT = crossT(prev, prevT, y, t, level);
+        }
+        return false;
+      }
+      if(!isEdge(prev, y, level, -slope))
+        return false;
+
+      // The pulse ends.
+      ts->phase = 0;
+      width = crossT(prev, prevT, y, t, level) - ts->pulseT;
+      *cross = level;
+      if(sw->trigger == QS_TRIGGER_PULSE_LESS)
+        return (width < sw->width);
+      return (width > sw->width);
+    }
+    case QS_TRIGGER_WINDOW:
+    {
+      float lo, hi;
+      bool in, wasIn;
+      lo = (level < sw->level2)?level:sw->level2;
+      hi = (level < sw->level2)?sw->level2:level;
+      in = (lo <= y && y <= hi);
+      wasIn = (lo <= prev && prev <= hi);
+
+      if(slope > 0 && in && !wasIn)
+      {
+        // It entered the window.
+        *cross = (prev < lo)?lo:hi;
+        return true;
+      }
+      if(slope < 0 && !in && wasIn)
+      {
+        // It left the window.
+        *cross = (y < lo)?lo:hi;
+        return true;
+      }
+      return false;
+    }
+    case QS_TRIGGER_RUNT:
+      if(!ts->phase && isEdge(prev, y, level, slope))
+        ts->phase = 1;
+      else if(ts->phase && isEdge(prev, y, level, -slope))
+      {
+        // It went back past level.  It's a runt if it did not get
+        // to level2.
+        bool runt;
+        runt = (ts->phase == 1);
+        ts->phase = 0;
+        *cross = level;
+        return runt;
+      }
+      if(ts->phase == 1 && slope*(y - sw->level2) >= 0.0F)
+        ts->phase = 2; // it's not a runt
+      return false;
+    case QS_TRIGGER_NTH_EDGE:
+      *cross = level;
+      return (isEdge(prev, y, level, slope) &&
+          ++ts->edgeCount >= sw->count);
+  }
+
+  return false;
+}
+
+// Like findEdge() but for the other trigger modes.  Returns the index
+// of the first value in the span that triggers, or span->len.
+static inline
+int findTrigger(struct QsSweep *sw, struct QsSweepTrigState *ts,
+    const struct QsIteratorSpan *span,
+    float prev, long double prevT, float *cross)
+{
+  int k;
+
+  if(sw->trigger == QS_TRIGGER_NTH_EDGE)
+  {
+    // We can count edges with findEdge().
+    for(k = 0; k < span->len; ++k)
+    {
+      k += findEdge(span->x + k*span->stride, span->stride,
+          span->len - k, prev, sw->level, sw->slope);
+      if(k == span->len)
+        break;
+      if(++ts->edgeCount >= sw->count)
+      {
+        *cross = sw->level;
+        return k;
+      }
+      prev = span->x[k*span->stride];
+    }
+    return span->len;
+  }
+
+  for(k = 0; k < span->len; ++k)
+  {
+    float y;
+    long double t;
+    y = span->x[k*span->stride];
+    t = span->time[span->timeIndex[k]];
+    if(triggerStep(sw, ts, prev, prevT, y, t, cross))
+      return k;
+    prev = y;
+    prevT = t;
+  }
+  return span->len;
+}
+
+static inline
+void resetTrigger(struct QsSweepTrigState *ts)
+{
+  ts->phase = 0;
+  ts->edgeCount = 0;
+}
+
+// The segment period can't be more than the sweep period, since we
+// keep the sweep positions.
+static inline
+float segmentPeriodGet(const struct QsSweep *sw)
+{
+  if(sw->segmentPeriod > 0.0F && sw->segmentPeriod < sw->period)
+    return sw->segmentPeriod;
+  return sw->period;
+}
+
+// Start writing segment number segmentsDone.
+static inline
+void segmentStart(struct QsSweep *sw, long double triggerT)
+{
+  struct QsSweepSegment *seg;
+  seg = sw->segments + sw->segmentsDone % sw->numSegments;
+  seg->triggerT = triggerT;
+  seg->len = 0;
+  sw->segStartT = triggerT + sw->delay;
+  sw->segmentOpen = true;
+}
+
+// Add the sweep position and input value to the segment that we
+// are capturing.  Returns true if the segment is full.
+static inline
+bool segmentAdd(struct QsSweep *sw, float pos, float y)
+{
+  struct QsSweepSegment *seg;
+  int slot;
+  slot = sw->segmentsDone % sw->numSegments;
+  seg = sw->segments + slot;
+
+  if(seg->len < sw->segmentLen)
+  {
+    float *data;
+    data = sw->segmentData + 2*(slot*sw->segmentLen + seg->len);
+    data[0] = pos;
+    data[1] = y;
+    ++seg->len;
+  }
+  return (seg->len >= sw->segmentLen);
+}
+
+// Close the segment and arm for the next one right away, with no
+// hold off.
+static inline
+void segmentClose(struct QsSweep *sw)
+{
+  sw->segmentOpen = false;
+  ++sw->segmentsDone;
+  resetTrigger(&sw->segTrig);
+  qsIterator_copy(sw->segBackIt, sw->segIt);
+  // So the first value after we arm is not an edge.
+  sw->segPrevY = (sw->slope < 0)?-INFINITY:INFINITY;
+}
+
+// The segments are captured with their own iterator and trigger
+// state, and not by the sweep that we draw, so that we arm for the
+// next segment as soon as one is full, and not after the rest of the
+// sweep period and the hold off.  That way a burst of triggers that
+// are closer than the sweep period fills segments, as fast as the
+// segment period allows.
+static
+void captureSegments(struct QsSweep *sw)
+{
+  struct QsIterator *it;
+  float y, prev, period, segmentPeriod;
+  long double t, prevT;
+  it = sw->segIt;
+  prev = sw->segPrevY;
+  prevT = sw->segPrevT;
+  period = sw->period;
+  segmentPeriod = segmentPeriodGet(sw);
+
+  while(qsIterator_get(it, &y, &t))
+  {
+    if(!sw->segmentOpen)
+    {
+      bool triggered;
+      float cross = sw->level;
+
+      if(t <= sw->segTrigValueT)
+      {
+        // With a negative delay we can read the values before the
+        // last trigger again, but we don't trigger on them again.
+        prev = y;
+        prevT = t;
+        continue;
+      }
+
+      if(!sw->slope)
+        // free run
+        triggered = true;
+      else if(sw->trigger == QS_TRIGGER_EDGE)
+        triggered = isEdge(prev, y, sw->level, sw->slope);
+      else
+        triggered = triggerStep(sw, &sw->segTrig, prev, prevT, y, t, &cross);
+
+      if(!triggered)
+      {
+        prev = y;
+        prevT = t;
+        continue;
+      }
+
+      segmentStart(sw, (sw->slope)?crossT(prev, prevT, y, t, cross):t);
+      sw->segTrigValueT = t;
+
+      if(sw->delay < 0)
+      {
+        // Go back to the start of the pre-trigger window, but not
+        // before where we armed.  The value that triggered is after
+        // segStartT, so this finds one.
+        qsIterator_copy(it, sw->segBackIt);
+        qsIterator_seekTime(it, sw->segStartT, &y, &t, NULL);
+      }
+    }
+
+    prev = y;
+    prevT = t;
+
+    if(t < sw->segStartT)
+      // Waiting for a positive delay.
+      continue;
+
+    if(segmentAdd(sw, (float) ((t - sw->segStartT)/period) - 0.5F, y) ||
+        t - sw->segStartT >= segmentPeriod)
+    {
+      segmentClose(sw);
+      prev = sw->segPrevY;
+    }
+  }
+
+  sw->segPrevY = prev;
+  sw->segPrevT = prevT;
+}
+
 static
 int cb_sweep(struct QsSweep *sw)
 {
@@ -79,6 +468,9 @@ int cb_sweep(struct QsSweep *sw)
   long double *tOut = NULL;
   float period;
   period = sw->period;
+
+  if(sw->segments)
+    captureSegments(sw);
  
   if(!sw->slope && !sw->delay && !sw->holdOff && 0)
   {
@@ -146,6 +538,7 @@ int cb_sweep(struct QsSweep *sw)
                 prevValueRead = INFINITY;
               else if(slope < 0)
                 prevValueRead = -INFINITY;
+              resetTrigger(&sw->trig);
               state = ARMED;
               startT = holdoffUntilT;
               break;
@@ -162,50 +555,62 @@ int cb_sweep(struct QsSweep *sw)
       }
 
       
-      if(state == ARMED && slope > 0)
+      if(state == ARMED && slope)
       {
-        do
-          {
-            if(prevValueRead <= level &&
-                level <= y && prevValueRead < y)
-            {
-              state = TRIGGERED;
-              // reset flag
-              sw->wasHoldoff = false;
-              // linearly interpolate a start time
-              startT = prevTIn +
-                (level - prevValueRead)*(t - prevTIn)/(y - prevValueRead)
-                + sw->delay;
-               prevValueOut = -INFINITY;
-              break;
-            }
-            prevValueRead = y;
-            prevTIn = t;
-          }
-          while(qsIterator_get(tit, &y, &t));
-      }
-      else if(state == ARMED && slope < 0)
-      {
-        do
+        bool triggered;
+        float cross = level;
+        if(sw->trigger == QS_TRIGGER_EDGE)
+          triggered = isEdge(prevValueRead, y, level, slope);
+        else
+          triggered = triggerStep(sw, &sw->trig,
+              prevValueRead, prevTIn, y, t, &cross);
+
+        if(!triggered)
+        {
+          struct QsIteratorSpan span;
+          prevValueRead = y;
+          prevTIn = t;
+
+          // Hunt for the trigger a span of values at a time.
+          while(qsIterator_peekSpan(tit, &span, SPAN_LEN))
           {
-            if(prevValueRead >= level &&
-                level >= y && prevValueRead > y)
+            int k;
+            if(sw->trigger == QS_TRIGGER_EDGE)
+              k = findEdge(span.x, span.stride, span.len,
+                  prevValueRead, level, slope);
+            else
+              k = findTrigger(sw, &sw->trig, &span,
+                  prevValueRead, prevTIn, &cross);
+            if(k < span.len)
             {
-              state = TRIGGERED;
-              // reset flag
-              sw->wasHoldoff = false;
-              // linearly interpolate a start time
-              startT = prevTIn +
-                (level - prevValueRead)*(t - prevTIn)/(y - prevValueRead)
-                + sw->delay;
-              prevValueOut = -INFINITY;
+              if(k)
+              {
+                prevValueRead = span.x[(k-1)*span.stride];
+                prevTIn = span.time[span.timeIndex[k-1]];
+              }
+              y = span.x[k*span.stride];
+              t = span.time[span.timeIndex[k]];
+              qsIterator_skip(tit, k + 1);
+              triggered = true;
               break;
             }
-            
-            prevValueRead = y;
-            prevTIn = t;
+            k = span.len - 1;
+            prevValueRead = span.x[k*span.stride];
+            prevTIn = span.time[span.timeIndex[k]];
+            qsIterator_skip(tit, span.len);
           }
-          while(qsIterator_get(tit, &y, &t));
+        }
+
+        if(triggered)
+        {
+          state = TRIGGERED;
+          // reset flag
+          sw->wasHoldoff = false;
+          // linearly interpolate a start time
+          startT = crossT(prevValueRead, prevTIn, y, t, cross)
+            + sw->delay;
+          prevValueOut = -INFINITY;
+        }
       }
       else if(state == ARMED)
       {
@@ -246,30 +651,16 @@ int cb_sweep(struct QsSweep *sw)
       {
         QS_ASSERT(sw->delay < 0);
 
-        if(qsIterator_poll(sw->backIt, &y, &t))
-          // TODO: make a time finding iterator function.
-          // backup the iterator to an older time
-          // This is not so bad, we just need to re-read
-          // the last sweep of data, and not the whole
-          // buffer if it's much larger than the amount
-          // of data in a sweep period.
-          qsIterator_copy(tit, sw->backIt);
-        else
+        if(!qsIterator_poll(sw->backIt, &y, &t))
           break;
 
-        do
-          {
-            if(t >= startT)
-            {
-              state = RUN;
-              break;
-            }
-            prevTIn = t;
-            // TODO: This does a slow linear
-            // search to find t >= startT.
-            // Can we do better?
-          }
-          while(qsIterator_get(tit, &y, &t));
+        // backup the iterator to an older time and
+        // binary search for the first t >= startT.
+        qsIterator_copy(tit, sw->backIt);
+        if(qsIterator_seekTime(tit, startT, &y, &t, &prevTIn))
+          state = RUN;
+        else
+          prevTIn = t;
       }
 
       if(state == TRIGGERED)
@@ -416,6 +807,67 @@ void _qsSweep_setContStart(struct QsSweep *sweep)
     sweep->startT = sweep->prevTIn;
 }
 
+static
+void freeSegments(struct QsSweep *sweep)
+{
+  if(sweep->segments)
+  {
+    g_free(sweep->segments);
+    g_free(sweep->segmentData);
+  }
+  sweep->segments = NULL;
+  sweep->segmentData = NULL;
+  sweep->numSegments = 0;
+  sweep->segmentLen = 0;
+  sweep->segmentsDone = 0;
+  sweep->segmentOpen = false;
+}
+
+// Allocate numSegments segments that are long enough for a segment
+// period of input values, and arm for the first one.  The old
+// segments are lost.
+static
+void allocSegments(struct QsSweep *sweep, int numSegments)
+{
+  struct QsGroup *g;
+  float len;
+  int maxLen;
+
+  freeSegments(sweep);
+  if(numSegments <= 0)
+    return;
+
+  g = sweep->sourceIn->group;
+  maxLen = g->maxNumFrames;
+  // A little extra for sample rate jitter, and the end point.
+  len = segmentPeriodGet(sweep) * g->sampleRate * 1.1F + 2.0F;
+  if(g->sampleRate <= 0.0F || !(len < maxLen))
+    // We don't know the sample rate or it's more than the group
+    // ring buffer can hold anyway.
+    sweep->segmentLen = maxLen;
+  else
+    sweep->segmentLen = len;
+
+  sweep->numSegments = numSegments;
+  sweep->segments = g_malloc0(sizeof(*sweep->segments)*numSegments);
+  sweep->segmentData = g_malloc(sizeof(float)*2*
+      sweep->segmentLen*numSegments);
+
+  if(!sweep->segIt)
+  {
+    sweep->segIt = qsIterator_create(sweep->sourceIn,
+        sweep->timeIt->channel);
+    sweep->segBackIt = qsIterator_create(sweep->sourceIn,
+        sweep->timeIt->channel);
+  }
+  else
+    qsIterator_reInit(sweep->segIt);
+  qsIterator_copy(sweep->segBackIt, sweep->segIt);
+  resetTrigger(&sweep->segTrig);
+  sweep->segPrevY = (sweep->slope < 0)?-INFINITY:INFINITY;
+  sweep->segTrigValueT = -INFINITY;
+}
+
 static
 void cb_changePeriod(struct QsSweep *sweep)
 {
@@ -427,6 +879,10 @@ void cb_changePeriod(struct QsSweep *sweep)
   // We need enough samples in the period of the sweep.
   qsSource_setFrameRate((struct QsSource *) sweep, 30/sweep->period);
   qsSource_setScale((struct QsSource *) sweep, sweep->period);
+
+  if(sweep->segments && sweep->segmentPeriod <= 0.0F)
+    // The segments need to be a different length now.
+    allocSegments(sweep, sweep->numSegments);
 }
 
 static
@@ -449,9 +905,20 @@ void cb_changeSlope(struct QsSweep *sweep)
   else if(sweep->slope < 0)
     sweep->prevValueRead = -INFINITY;
 
+  resetTrigger(&sweep->trig);
+  resetTrigger(&sweep->segTrig);
   sweep->oldSlope = sweep->slope;
 }
 
+static
+void cb_changeTrigger(struct QsSweep *sweep)
+{
+  QS_ASSERT(sweep);
+  // Start looking for the new trigger from scratch.
+  resetTrigger(&sweep->trig);
+  resetTrigger(&sweep->segTrig);
+}
+
 static
 void cb_changeLevel(struct QsSweep *sweep)
 {
@@ -524,8 +991,15 @@ _qsSweep_destroy(struct QsSource *s)
     // options.
     qsIterator_destroy(((struct QsSweep *)s)->backIt);
     qsIterator_destroy(((struct QsSweep *)s)->timeIt);
+    if(((struct QsSweep *)s)->segIt)
+    {
+      qsIterator_destroy(((struct QsSweep *)s)->segIt);
+      qsIterator_destroy(((struct QsSweep *)s)->segBackIt);
+    }
   }
 
+  freeSegments((struct QsSweep *)s);
+
   // qsSource_checkBaseDestroy(s)
   // Is not needed since user cannot call this
   // static function.  qsSource_destroy() will
@@ -564,6 +1038,12 @@ struct QsSource *qsSweep_create(
   else
     sweep->prevValueRead = -INFINITY;
   sweep->prevValueOut = -INFINITY;
+  sweep->trigger = QS_TRIGGER_EDGE;
+  // If level2 was level the runt trigger would never fire, and the
+  // window would have no width.
+  sweep->level2 = level + ((slope < 0)?-1.0F:1.0F);
+  sweep->width = period/10;
+  sweep->count = 2;
   sweep->id = createCount++;
   sweep->backIt = qsIterator_create(sourceIn, channelNum);
   sweep->timeIt = qsIterator_create(sourceIn, channelNum);
@@ -634,6 +1114,40 @@ struct QsSource *qsSweep_create(
       slopeValues, label, 3 /* num values */,
       (void (*)(void *)) cb_changeSlope, sweep), sweep);
   }
+  {
+    int triggerValues[] =
+    {
+      QS_TRIGGER_EDGE, QS_TRIGGER_PULSE_LESS, QS_TRIGGER_PULSE_MORE,
+      QS_TRIGGER_WINDOW, QS_TRIGGER_RUNT, QS_TRIGGER_NTH_EDGE
+    };
+    const char *label[] =
+    {
+      "edge", "width <", "width >", "window", "runt", "Nth edge"
+    };
+
+    addIcon(
+      qsAdjusterSelector_create(adjL,
+      "Trigger", &sweep->trigger,
+      triggerValues, label, 6 /* num values */,
+      (void (*)(void *)) cb_changeTrigger, sweep), sweep);
+  }
+  addIcon(
+      /* level2 is the other side of the window,
+       * or the level that a runt does not get to. */
+      qsAdjusterFloat_create(adjL,
+      "Trigger Level 2", "", &sweep->level2,
+      -100.0, /* min */ 100.0, /* max */
+      (void (*)(void *)) cb_changeTrigger, sweep), sweep);
+  addIcon(
+      qsAdjusterFloat_create(adjL,
+      "Trigger Pulse Width", "sec", &sweep->width,
+      0.0F, /* min */ 1000.0F, /* max */
+      (void (*)(void *)) cb_changeTrigger, sweep), sweep);
+  addIcon(
+      qsAdjusterInt_create(adjL,
+      "Trigger Edge Count", "", &sweep->count,
+      1, /* min */ 1000000, /* max */
+      (void (*)(void *)) cb_changeTrigger, sweep), sweep);
 
   qsAdjusterGroup_end(adjG);
 
@@ -642,3 +1156,217 @@ struct QsSource *qsSweep_create(
   return (struct QsSource *) sweep;
 }
 
+
+void qsSweep_setTrigger(struct QsSource *s, enum QsSweepTrigger trigger,
+    float level2, float width, int count)
+{
+  QS_ASSERT(s);
+  QS_ASSERT(s->read == (QsSource_ReadFunc_t) cb_sweep ||
+      s->read == (QsSource_ReadFunc_t) cb_sweep_init);
+  QS_ASSERT(width >= 0.0F);
+  QS_ASSERT(count > 0);
+
+  struct QsSweep *sweep;
+  sweep = (struct QsSweep *) s;
+
+  QS_VASSERT(trigger != QS_TRIGGER_RUNT || level2 != sweep->level,
+      "A runt trigger with level2 == level (%g) never fires\n", level2);
+
+  sweep->trigger = trigger;
+  sweep->level2 = level2;
+  sweep->width = width;
+  sweep->count = count;
+  resetTrigger(&sweep->trig);
+  resetTrigger(&sweep->segTrig);
+}
+
+void qsSweep_setSegments(struct QsSource *s, int numSegments,
+    float segmentPeriod)
+{
+  QS_ASSERT(s);
+  QS_ASSERT(s->read == (QsSource_ReadFunc_t) cb_sweep ||
+      s->read == (QsSource_ReadFunc_t) cb_sweep_init);
+  QS_ASSERT(numSegments >= 0);
+  QS_ASSERT(segmentPeriod >= 0.0F);
+
+  ((struct QsSweep *) s)->segmentPeriod = segmentPeriod;
+  allocSegments((struct QsSweep *) s, numSegments);
+}
+
+// Returns segment number n, counting from 0 as they were captured, or
+// NULL if it's not captured or it got written over.
+static inline
+const struct QsSweepSegment *getSegment(const struct QsSweep *sw, int n,
+    const float **data)
+{
+  int slot;
+
+  if(!sw->segments || n < 0 || n >= sw->segmentsDone ||
+      // The oldest one may be getting written over now.
+      n < sw->segmentsDone - sw->numSegments + ((sw->segmentOpen)?1:0))
+    return NULL;
+
+  slot = n % sw->numSegments;
+  *data = sw->segmentData + 2*slot*sw->segmentLen;
+  return sw->segments + slot;
+}
+
+int qsSweep_getSegment(struct QsSource *s, int n,
+    const float **data, long double *triggerT)
+{
+  QS_ASSERT(s);
+  QS_ASSERT(data);
+
+  struct QsSweep *sw;
+  const struct QsSweepSegment *seg;
+  sw = (struct QsSweep *) s;
+
+  seg = getSegment(sw, sw->segmentsDone - 1 - n, data);
+  if(!seg)
+    return 0;
+  if(triggerT)
+    *triggerT = seg->triggerT;
+  return seg->len;
+}
+
+
+// A source that plays the sweep segments back.  It writes one
+// (sweep position, value) pair per frame, with a pen lift between
+// segments.
+struct QsSweepSegments
+{
+  // inherit QsSource
+  struct QsSource source;
+  struct QsSweep *sweep;
+  int sweepID;
+  // 0 to play all the segments, one after the other, so that they
+  // overlay with fade, or n to play the n-th newest segment again
+  // and again.
+  int show;
+  int n; // the segment number that we are playing
+  int k; // the next value in segment n to play
+  int id;
+};
+
+static
+int cb_segments(struct QsSweepSegments *ss)
+{
+  struct QsSource *s;
+  struct QsSweep *sw;
+  int numFrames;
+
+  s = (struct QsSource *) ss;
+  sw = ss->sweep;
+
+  if(!g_slist_find(qsApp->sources, sw) || ((struct QsSource *) sw)->id !=
+      ss->sweepID)
+    return -1; // The sweep is gone, so are we.
+
+  numFrames = qsSource_numFrames(s);
+  if(!numFrames)
+    return 0;
+
+  while(numFrames--)
+  {
+    const struct QsSweepSegment *seg;
+    const float *data;
+    long double *t;
+    float *val;
+
+    seg = getSegment(sw, ss->n, &data);
+
+    if(!seg || ss->k >= seg->len)
+    {
+      // Go to the next segment to play.
+      if(ss->show > 0)
+        ss->n = sw->segmentsDone - ss->show;
+      else if(!seg || ss->n + 1 >= sw->segmentsDone)
+        // Start over at the oldest one.
+        ss->n = sw->segmentsDone - sw->numSegments +
+          ((sw->segmentOpen)?1:0);
+      else
+        ++ss->n;
+      if(ss->n < 0)
+        ss->n = 0;
+      ss->k = 0;
+
+      // Lift the pen between segments.
+      if(!(val = qsSource_setFrame(s, &t)))
+        break;
+      val[0] = val[1] = QS_LIFT;
+      continue;
+    }
+
+    if(!(val = qsSource_setFrame(s, &t)))
+      break;
+    val[0] = data[2*ss->k];
+    val[1] = data[2*ss->k + 1];
+    ++ss->k;
+  }
+
+  return 1;
+}
+
+static
+size_t segmentsIconText(char *buf, size_t len, struct QsSweepSegments *ss)
+{
+  return snprintf(buf, len,
+      "<span bgcolor=\"#FF86C5\" fgcolor=\"#97C81F\">["
+      "<span fgcolor=\"#3F3A21\">segments%d</span>"
+      "]</span> ", ss->id);
+}
+
+struct QsSource *qsSweep_createSegmentSource(struct QsSource *sweep)
+{
+  QS_ASSERT(sweep);
+  QS_ASSERT(sweep->read == (QsSource_ReadFunc_t) cb_sweep ||
+      sweep->read == (QsSource_ReadFunc_t) cb_sweep_init);
+
+  struct QsSweepSegments *ss;
+  struct QsSweep *sw;
+  sw = (struct QsSweep *) sweep;
+
+  if(!sw->segments)
+    // Make some segments so that this does something.
+    allocSegments(sw, 16);
+
+  ss = qsSource_create(
+      (QsSource_ReadFunc_t) cb_segments,
+      2 /*numChannels*/,
+      0 /*maxNumFrames*/,
+      sweep /*source group*/,
+      sizeof(*ss));
+
+  ss->sweep = sw;
+  ss->sweepID = sweep->id;
+  ss->id = sw->id;
+  ss->n = -1;
+
+  const float minMaxSampleRates[] = { 0.01F , 2*44100.0F };
+  qsSource_setFrameRateType((struct QsSource *) ss, QS_TOLERANT,
+      minMaxSampleRates, 1.0F);
+  {
+    const float scales[] =
+      { sw->period, sw->sourceIn->scale[sw->timeIt->channel] };
+    qsSource_setScales((struct QsSource *) ss, scales);
+  }
+
+  struct QsAdjuster *adjG;
+  struct QsAdjusterList *adjL;
+  adjL = (struct QsAdjusterList *) ss;
+
+  adjG = qsAdjusterGroup_start(adjL, "Sweep Segments");
+  qsAdjuster_setIconStrFunc(adjG,
+      (size_t (*)(char *, size_t, void *)) segmentsIconText, ss);
+  qsAdjuster_setIconStrFunc(
+      /* 0 overlays all the segments, n steps to the n-th newest
+       * segment. */
+      qsAdjusterInt_create(adjL,
+      "Show Segment", "", &ss->show,
+      0, /* min */ 100000, /* max */
+      NULL, NULL),
+      (size_t (*)(char *, size_t, void *)) segmentsIconText, ss);
+  qsAdjusterGroup_end(adjG);
+
+  return (struct QsSource *) ss;
+}
@@ -7,6 +7,7 @@
 #include <math.h>
 #include <inttypes.h>
 #include <string.h>
+#include <stdlib.h>
 #include <stdbool.h>
 #include <gtk/gtk.h>
 #include "debug.h"
@@ -22,11 +23,75 @@
 #include "swipe_priv.h"
 
 
+static
+int compareRows(const void *a, const void *b)
+{
+  return ((int) *(const uint16_t *) a) - ((int) *(const uint16_t *) b);
+}
+
+void _qsSwipe_growColumn(struct QsSwipeColumn *col, int height)
+{
+  QS_ASSERT(col && col->len == col->alloc);
+
+  if(col->alloc >= height)
+  {
+    // There must be repeated rows in here, from a trace that goes up
+    // and down in the same column more than once.  We remove them.
+    // The order of the rows does not matter.
+    int k, n = 0;
+    qsort(col->row, col->len, sizeof(*col->row), compareRows);
+    for(k = 0; k < col->len; ++k)
+      if(!n || col->row[n-1] != col->row[k])
+        col->row[n++] = col->row[k];
+    col->len = n;
+    if(col->len < col->alloc)
+      return;
+  }
+
+  col->alloc = (col->alloc)?(col->alloc * 2):8;
+  col->row = g_realloc(col->row, sizeof(*col->row)*col->alloc);
+}
+
+static
+void freeColumns(struct QsSwipe *swipe)
+{
+  int x;
+  if(!swipe->column) return;
+  for(x = 0; x < swipe->width; ++x)
+    if(swipe->column[x].row)
+      g_free(swipe->column[x].row);
+  g_free(swipe->column);
+  swipe->column = NULL;
+  swipe->width = 0;
+}
+
+// Returns the smallest id, from 1 to 255, that is not used by
+// another swiping trace in the window, or 0 if there are none.
+static
+uint8_t getSwipeId(struct QsTrace *trace)
+{
+  int id;
+  for(id = 1; id < 256; ++id)
+  {
+    GSList *l;
+    for(l = trace->win->traces; l; l = l->next)
+    {
+      struct QsTrace *t;
+      t = l->data;
+      if(t != trace && t->swipe && t->swipe->id == id)
+        break;
+    }
+    if(!l)
+      return id;
+  }
+  return 0;
+}
+
 // Just to initialize, without resize and allocating.
 void _qsTrace_initSwipe(struct QsTrace *trace)
 {
   QS_ASSERT(trace && trace->win);
-  QS_ASSERT(trace->swipe && trace->swipe->surface);
+  QS_ASSERT(trace->swipe);
   QS_ASSERT((void *) trace->swipe != (void *) 1);
 
   if(!trace->win->gc)
@@ -36,27 +101,38 @@ void _qsTrace_initSwipe(struct QsTrace *trace)
     return;
 
   struct QsSwipe *swipe;
-  struct QsWin *win;
+  int x;
 
-  win = trace->win;
   swipe = trace->swipe;
-  swipe->start = swipe->end = NULL;
-  swipe->lapCount = swipe->pointCount = trace->win->swipePointCount - 1;
-  swipe->lastSwipedCount = swipe->pointCount - 10;
+  QS_ASSERT(swipe->column);
   swipe->lastValueAdded = -1;
-  swipe->lastSwipedValue = -1;
+  swipe->eraseX = 0;
+  swipe->eraseLap = swipe->lap;
   swipe->freezeLapCount = 0;
 
-  struct QsSwipeColor *sc;
-  int i, n;
-  n = win->width * win->height;
-  for(sc = swipe->surface, i = 0; i < n; ++i)
+  for(x = 0; x < swipe->width; ++x)
   {
-    sc->next = NULL;
-    ++sc;
+    swipe->column[x].len = 0;
+    swipe->column[x].lap = swipe->lap;
   }
 }
 
+// Make a cleared top trace map if there is none for this window
+// size.  We compare width and height, not just the area, because the
+// map is indexed by width*y + x.
+static
+void makeSwipeTop(struct QsWin *win)
+{
+  if(win->swipeTop && win->swipeTopWidth == win->width &&
+      win->swipeTopHeight == win->height)
+    return;
+  if(win->swipeTop)
+    g_free(win->swipeTop);
+  win->swipeTopWidth = win->width;
+  win->swipeTopHeight = win->height;
+  win->swipeTop = g_malloc0(win->width * win->height);
+}
+
 // This may be called to create or resize the swipe thingy.
 // _qsWin_drawGrid() must be called after this.
 void _qsTrace_reallocSwipe(struct QsTrace *trace)
@@ -68,50 +144,122 @@ void _qsTrace_reallocSwipe(struct QsTrace *trace)
   win = trace->win;
 
   if(!trace->swipe)
+  {
     trace->swipe = swipe = g_malloc0(sizeof(*swipe));
+    swipe->id = getSwipeId(trace);
+    if(!swipe->id)
+      QS_SPEW("too many swiping traces in one window\n");
+  }
   else
   {
     swipe = trace->swipe;
-    struct QsSwipeColor *surface;
-    surface = swipe->surface;
-    // reset all swipe data
-    memset(swipe, 0, sizeof(*swipe));
-    // but remember the surface buffer
-    swipe->surface = surface;
+    // reset all swipe data, but remember the columns and id
+    freeColumns(swipe);
+    swipe->lap = 0;
   }
 
   if(!win->gc)
     // We need the drawing area width and height
     return; // we should have X11 window stuff setup later.
 
+  // All the swiping traces get reset with the window size.
+  makeSwipeTop(win);
 
-  
-#ifdef QS_DEBUG
-  // Some value a little less than width
-  swipe->xMid = 2*win->width/3;
-#endif
+  swipe->width = win->width;
+  swipe->height = win->height;
+  swipe->column = g_malloc0(sizeof(*swipe->column) * swipe->width);
+  swipe->lastValueAdded = -1;
+  swipe->eraseX = 0;
+  swipe->eraseLap = swipe->lap;
+
+  trace->isSwipe = true;
+}
 
-  if(swipe->surface)
-    g_free(swipe->surface);
+bool _qsTrace_resampleSwipe(struct QsTrace *trace)
+{
+  QS_ASSERT(trace && trace->win);
+  QS_ASSERT(trace->swipe);
 
-  swipe->surface = g_malloc0(sizeof(*swipe->surface) *
-      win->width * win->height);
+  struct QsSwipe *swipe;
+  struct QsSwipeColumn *old;
+  struct QsWin *win;
+  int oldW, oldH, w, h, ox;
 
-  trace->isSwipe = true;
+  win = trace->win;
+  swipe = trace->swipe;
+
+  if(!win->gc || !swipe->column || swipe->width <= 0 ||
+      swipe->height <= 0 ||
+      (swipe->width == win->width && swipe->height == win->height))
+    return false;
+
+  w = win->width;
+  h = win->height;
+  oldW = swipe->width;
+  oldH = swipe->height;
+  old = swipe->column;
+
+  // The first swiping trace to get here makes the new top trace
+  // map, and each trace marks its pixels in it.
+  makeSwipeTop(win);
+
+  swipe->column = g_malloc0(sizeof(*swipe->column) * w);
+  swipe->width = w;
+  swipe->height = h;
+
+  for(ox = 0; ox < oldW; ++ox)
+  {
+    struct QsSwipeColumn *oc;
+    int x0, x1, x;
+    oc = old + ox;
+    _qsWin_resampleSpan(ox, oldW, w, &x0, &x1);
+
+    for(x = x0; x < x1; ++x)
+    {
+      struct QsSwipeColumn *col;
+      int k;
+      col = swipe->column + x;
+
+      // When old columns merge, the column gets the latest lap.
+      if(!col->len || oc->lap - col->lap > 0)
+        col->lap = oc->lap;
+      if(!col->len || oc->stamp - col->stamp > 0)
+        col->stamp = oc->stamp;
+
+      for(k = 0; k < oc->len; ++k)
+      {
+        int y0, y1, y;
+        _qsWin_resampleSpan(oc->row[k], oldH, h, &y0, &y1);
+        for(y = y0; y < y1; ++y)
+        {
+          if(col->len && col->row[col->len - 1] == y)
+            continue;
+          if(col->len == col->alloc)
+            _qsSwipe_growColumn(col, h);
+          col->row[col->len++] = y;
+          win->swipeTop[w * y + x] = swipe->id;
+        }
+      }
+    }
+    if(oc->row)
+      g_free(oc->row);
+  }
+  g_free(old);
+
+  // The sweep x values are for the new width now.
+  swipe->eraseX = (swipe->eraseX * w)/oldW;
+  if(swipe->lastValueAdded >= 0)
+    swipe->lastValueAdded = (swipe->lastValueAdded * w)/oldW;
+
+  return true;
 }
 
 void _qsTrace_cleanupSwipe(struct QsTrace *trace)
 {
   QS_ASSERT(trace && trace->win);
-  QS_ASSERT(trace->swipe && trace->swipe->surface);
+  QS_ASSERT(trace->swipe);
 
-#ifdef QS_DEBUG
-  memset(trace->swipe->surface, 0,
-      sizeof(*trace->swipe->surface) *
-      trace->win->width * trace->win->height);
-#endif
-
-  g_free(trace->swipe->surface);
+  freeColumns(trace->swipe);
 
 #ifdef QS_DEBUG
   memset(trace->swipe, 0, sizeof(*trace->swipe));
@@ -126,9 +274,20 @@ void qsTrace_setSwipeX(struct QsTrace *trace, bool on)
 {
   QS_ASSERT(trace && trace->win);
 
+  if(trace->win->gl)
+  {
+    // The OpenGL back end does not do swipe, so we do not keep any
+    // swipe state that nothing will draw with.
+    QS_ASSERT(!trace->swipe);
+    trace->isSwipe = false;
+    return;
+  }
+
   if((trace->swipe && on) || (!trace->swipe && !on))
     return;
 
+  _qsWin_renderPause(trace->win);
+
   if(on)
   {
     // Make a swipe thingy
@@ -139,5 +298,7 @@ void qsTrace_setSwipeX(struct QsTrace *trace, bool on)
   {
     _qsTrace_cleanupSwipe(trace);
   }
+
+  _qsWin_renderResume(trace->win);
 }
 
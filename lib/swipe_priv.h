@@ -2,37 +2,41 @@
  * Copyright (C) 2012-2014  Lance Arsenault
  * GNU General Public License version 3
  */
-struct QsSwipeColor
+
+/* The swipe keeps, for each X pixel column, a short array of the
+ * Y rows that the trace drew in that column, and the trace lap that
+ * drew them.  Swiping away column x is just a pass over its rows.
+ * That is a lot less memory than a list node for every drawing area
+ * pixel, for every swiping trace.
+ *
+ * Which trace is on top at a pixel is in the window byte map
+ * win->swipeTop, so when we swipe a pixel we only look at the other
+ * traces if we were the trace on top there. */
+struct QsSwipeColumn
 {
-  /* It's a singly linked list of pixels. */
-  struct QsSwipeColor *next;
-  /* since the trace can wrap (trace) around the view port any number
-   * of times we need to keep a track of what generation the trace is
-   * at, so that we can clear traces that wrap many times.  If this counter
-   * gets incremented (wraps) through INT_MIN it will not matter, it just
-   * can't go through all ints (2^31) in one trace draw cycle. */
-  int pointCount;
+  uint16_t *row; /* y values of the pixels drawn in this column */
+  uint16_t len, alloc;
+  int lap; /* the swipe lap that drew the rows */
+  int stamp; /* win->swipePointCount at the last draw in this column */
 };
 
 struct QsSwipe
 {
-  /* surface: is a pointer to the allocated memory
-   * one QsSwipeColor per pixel in the drawing area.
-   * start: is the start of the list in this pixel memory. */
-  struct QsSwipeColor *surface, *start, *end;
-  /* Each time the inputed X (or Y) value decreases (wraps back to zero)
-   * we increment pointCount. */
-  int pointCount, lastValueAdded,
-      lastSwipedCount, lastSwipedValue,
-      /* lapCount is the value of win->swipePointCount at the
-       * time of the last trace view port crossing */
-      lapCount, freezeLapCount;
-
-#ifdef QS_DEBUG
-  // Used for testing that x is always increasing or wrapping
-  // back through zero.
-  int xMid;
-#endif
+  struct QsSwipeColumn *column; /* one per drawing area X pixel */
+  int width; /* number of columns */
+  int height; /* drawing area height that the rows are for */
+
+  /* Each time the inputed X value decreases (wraps back to zero)
+   * we increment lap.  The lap and counter differences work when
+   * the counters overflow through INT_MAX. */
+  int lap, lastValueAdded;
+  /* The columns less than eraseX are swiped for lap eraseLap. */
+  int eraseX, eraseLap;
+  int freezeLapCount;
+
+  /* Our value in win->swipeTop, or 0 if there were too many swiping
+   * traces in the window. */
+  uint8_t id;
 };
 
 // called to construct or resize the viewport
@@ -53,56 +57,115 @@ void _qsTrace_cleanupSwipe(struct QsTrace *trace);
 extern
 void _qsTrace_initSwipe(struct QsTrace *trace);
 
+// Called when the view port width or height changed to map the
+// swiped pixels into the new size.  Returns false if there is nothing
+// to keep and the swipe needs _qsTrace_reallocSwipe().
+extern
+bool _qsTrace_resampleSwipe(struct QsTrace *trace);
+
+// Makes room for more rows in column col.
+extern
+void _qsSwipe_growColumn(struct QsSwipeColumn *col, int height);
+
+
+// Returns true if the swipe has pixel x, y.
+static inline
+bool _qsSwipe_has(const struct QsSwipe *swipe, int x, int y)
+{
+  const struct QsSwipeColumn *col;
+  int k;
+  col = swipe->column + x;
+  for(k = 0; k < col->len; ++k)
+    if(col->row[k] == y)
+      return true;
+  return false;
+}
+
+// Returns the trace that is drawn on top at pixel x, y, or NULL
+// if no swiping trace is drawn there.
+static inline
+struct QsTrace *_qsWin_swipeTopTrace(struct QsWin *win, int x, int y)
+{
+  GSList *l;
+  uint8_t top;
+
+  if(!win->swipeTop)
+    return NULL;
+
+  top = win->swipeTop[win->width * y + x];
+  if(!top)
+    return NULL;
+
+  for(l = win->traces; l; l = l->next)
+  {
+    struct QsTrace *t;
+    t = l->data;
+    if(t->swipe && t->swipe->id == top)
+      return (_qsSwipe_has(t->swipe, x, y))?t:NULL;
+  }
+  return NULL;
+}
+
 /* This is for when a pixel (x,y) is swiped away in one trace
- * and the same pixel (x,y) is drawn by this in a different trace or
- * just draw the top trace, in the traces list, at a given pixel. */
-static inline // redraw one pixel if we find it return 0 else return 1
+ * and the same pixel (x,y) is drawn by this in a different trace.
+ * If another trace is on top there we do nothing, else we draw the
+ * most recent other trace that has the pixel.
+ * Returns 0 if the pixel is drawn or 1 if it needs the background. */
+static inline
 int _qsWin_redrawSwipePoint(struct QsWin *win, struct QsTrace *trace,
-    GSList *traces,
-    int xyIndex, int x, int y, int pointCount)
+    int x, int y)
 {
+  struct QsTrace *topTrace;
+  uint8_t *top;
+  top = win->swipeTop + win->width * y + x;
+
+  if(*top != trace->swipe->id || !*top)
+  {
+    topTrace = _qsWin_swipeTopTrace(win, x, y);
+    if(topTrace && topTrace != trace)
+      // It's still drawn with that trace on top.
+      return 0;
+  }
+
+  *top = 0;
+
   if(!win->traces->next)
     return 1; // there is just one trace
-  
-  if(!traces) traces = win->traces;
 
   GSList *l;
-  struct QsTrace *foundTrace = NULL;
+  int stamp = 0;
+  topTrace = NULL;
 
-  for(l = traces; l; l = l->next)
+  for(l = win->traces; l; l = l->next)
   {
     struct QsTrace *t;
     t = l->data;
     QS_ASSERT(t);
-    if(t != trace && t->swipe)
+    if(t != trace && t->swipe && _qsSwipe_has(t->swipe, x, y) &&
+        // difference works even with overflow:
+        (!topTrace || t->swipe->column[x].stamp - stamp > 0))
     {
-      struct QsSwipeColor *sc;
-      sc = t->swipe->surface + xyIndex;
-      if((sc->next || sc == t->swipe->end) &&
-          // difference works even with overflow:
-          sc->pointCount - pointCount > 0)
-      {
-        foundTrace = t;
-        pointCount = sc->pointCount;
-      }
+      topTrace = t;
+      stamp = t->swipe->column[x].stamp;
     }
   }
 
-  if(foundTrace)
+  if(topTrace)
   {
+    *top = topTrace->swipe->id;
     setTraceColor(win, getXColor(win,
-          (uint8_t) (foundTrace->red   * RMAX + 0.5F),
-          (uint8_t) (foundTrace->green * GMAX + 0.5F),
-          (uint8_t) (foundTrace->blue  * BMAX + 0.5F)));
+          (uint8_t) (topTrace->red   * RMAX + 0.5F),
+          (uint8_t) (topTrace->green * GMAX + 0.5F),
+          (uint8_t) (topTrace->blue  * BMAX + 0.5F)));
     xDrawPoint(win, x, y);
     // _qsWin_drawPoints(win); will get called later
     return 0;
   }
-  
+
   return 1;
 }
 
-// redraw the traces from the swipe pixel buffers.
+// redraw the traces from the swipe column buffers.
 static inline
 void _qsWin_traceSwipeRedraws(struct QsWin *win)
 {
@@ -110,38 +173,36 @@ void _qsWin_traceSwipeRedraws(struct QsWin *win)
   int w;
   w = win->width;
 
-  GSList *l, *traces;
-  traces = win->traces;
+  GSList *l;
 
-  for(l = traces; l; l = l->next)
+  for(l = win->traces; l; l = l->next)
   {
     struct QsTrace *trace;
+    struct QsSwipe *swipe;
     trace = l->data;
+    swipe = trace->swipe;
 
-    if(trace->swipe)
+    if(swipe && swipe->column)
     {
-      struct QsSwipeColor *sc, *SC;
-      SC = trace->swipe->surface;
-      QS_ASSERT(SC);
       uint8_t r, g, b;
+      int x;
       r = trace->red*RMAX;
       g = trace->green*GMAX;
       b = trace->blue*BMAX;
+      setTraceColor(win, getXColor(win, r, g, b));
 
-      // TODO: this could be pretty slow if there
-      // are a lot of traces.
-
-      for(sc = trace->swipe->start; sc; sc = sc->next)
+      for(x = 0; x < swipe->width; ++x)
       {
-        int x, y;
-        y = (sc - SC)/w;
-        x = (sc - SC) - y*w;
-        // Figure out which trace is drawn on top
-        if(_qsWin_redrawSwipePoint(win, trace, traces,
-              w * y + x, x, y, sc->pointCount))
+        struct QsSwipeColumn *col;
+        int k;
+        col = swipe->column + x;
+        for(k = 0; k < col->len; ++k)
         {
-          setTraceColor(win, getXColor(win, r, g, b));
-          xDrawPoint(win, x, y);
+          uint8_t top;
+          top = win->swipeTop[w * col->row[k] + x];
+          // Draw it if we are the trace on top.
+          if(top == swipe->id || !top)
+            xDrawPoint(win, x, col->row[k]);
         }
       }
     }
@@ -157,44 +218,44 @@ void _qsWin_traceSwipeRedraws(struct QsWin *win)
 // the same time.  There may be a reason to use both.  It sounds
 // like fun anyway.
 
-/* Remove a pixel link from the fading pixel buffer (not the swipe pixel
- * buffer) */
+/* Remove a pixel from the fading pixel buffer (not the swipe pixel
+ * buffer).  The pixel index is left in its fade queue bucket, but
+ * it's stale now and will be skipped. */
 static inline
 void _qsWin_removeFadePixel(struct QsWin *win, int w, int x, int y)
 {
   if(win->fade)
   {
     QS_ASSERT(win && win->fadeSurface);
-    struct QsFadingColor *fc;
-    fc = win->fadeSurface + w*y + x;
+    win->fadeSurface[w*y + x].tick = 0;
+  }
+}
 
-    if(fc == win->fadeLastInsert)
-      win->fadeLastInsert = NULL;
+// Swipe away all the pixels in column x.
+static inline
+void _qsWin_swipeColumn(struct QsWin *win, struct QsTrace *trace,
+    struct QsSwipe *swipe, int x)
+{
+  struct QsSwipeColumn *col;
+  int k, w;
 
-    if(fc->prev)
-    {
-      fc->prev->next = fc->next;
-    }
-    else if(fc == win->fadeRear)
-    {
-      win->fadeRear = fc->next;
-      if(fc->next)
-        fc->next->prev = NULL;
-    }
+  col = swipe->column + x;
+  w = win->width;
 
-    if(fc->next)
-    {
-      fc->next->prev = fc->prev;
-      fc->next = NULL; // must be NULLed
-    }
-    else if(fc == win->fadeFront)
+  for(k = 0; k < col->len; ++k)
+  {
+    int y, i;
+    y = col->row[k];
+    i = w * y + x;
+    _qsWin_removeFadePixel(win, w, x, y);
+    if(_qsWin_redrawSwipePoint(win, trace, x, y))
     {
-      win->fadeFront = fc->prev;
-      if(fc->prev)
-        fc->prev->next = NULL;
+      setTraceColor(win, bgPlaneColor(win, i));
+      xDrawPoint(win, x, y);
+      // _qsWin_drawPoints(win); will get called later
     }
-    fc->prev = NULL; // must be NULLed
   }
+  col->len = 0;
 }
 
 // swipe pixels to and including xEnd
@@ -204,110 +265,45 @@ static inline
 void _qsWin_swipeRemove(struct QsWin *win, struct QsTrace *trace,
     struct QsSwipe *swipe, int xEnd)
 {
-  if(!swipe->start) return;
+  int lap, x;
 
-  // Don't swipe/remove if this xEnd is the same as the last one.
-  if(swipe->lastSwipedValue == xEnd &&
-    swipe->lastSwipedCount == swipe->pointCount)
-    return;
-
-  swipe->lastSwipedValue = xEnd;
-  swipe->lastSwipedCount = swipe->pointCount;
-
-  struct QsSwipeColor *sc, *surface, *next;
-  int i, w, x, y;
-  int lapCount;
-  uint8_t *r, *g, *b;
+  if(!swipe->column) return;
 
-  r = win->r; g = win->g; b = win->b;
-  surface = swipe->surface;
-  w = win->width;
-
-  sc = swipe->start;
-  y = (sc - surface)/w;
-  x = (sc - surface) - y*w;
-  lapCount = swipe->lapCount;
+  QS_ASSERT(xEnd >= 0 && xEnd < swipe->width);
 
+  // The lap that the pixels up to xEnd will be drawn in.
+  lap = swipe->lap;
+  if(xEnd < swipe->lastValueAdded)
+    // It's about to wrap.
+    ++lap;
 
-  if(xEnd >= swipe->lastValueAdded)
+  if(swipe->eraseLap != lap)
   {
-    // swipe to X = xEnd in the lap before the current lap
-    // by using lapCount - sc->pointCount > 0  works
-    // when the numbers go through INT_MAX to INT_MIN.
-    while(lapCount - sc->pointCount > 0 && x <= xEnd)
-    {
-      next = sc->next;
-
-      i = w * y + x;
-      _qsWin_removeFadePixel(win, w, x, y);
-
-      if(_qsWin_redrawSwipePoint(win, trace, win->traces,
-            w * y + x, x, y, sc->pointCount - 5*(INT_MAX/12)))
-      {
-        setTraceColor(win, getXColor(win, r[i], g[i], b[i]));
-        xDrawPoint(win, x, y);
-        // _qsWin_drawPoints(win); will get called later
-      }
-      sc->next = NULL;
-
-      if(!next)
-      {
-        // We have swiped the whole list.
-        swipe->start = swipe->end = NULL;
-        swipe->lastValueAdded = -1;
-        return;
-      }
-
-      sc = next;
-      y = (sc - surface)/w;
-      x = (sc - surface) - y*w;
-    }
-
-    swipe->start = sc;
-    return;
+    // We are starting a new lap.  The columns that are not swiped
+    // yet from the lap before last get swiped now.
+    for(x = swipe->eraseX; x < swipe->width; ++x)
+      if(swipe->column[x].len && lap - swipe->column[x].lap > 1)
+        _qsWin_swipeColumn(win, trace, swipe, x);
+    swipe->eraseLap = lap;
+    swipe->eraseX = 0;
   }
 
-  // swipe to X = xEnd in the (last) trace
-  while(x <= xEnd || lapCount - sc->pointCount > 0)
-  {
-    next = sc->next;
-
-    i = w * y + x;
-    _qsWin_removeFadePixel(win, w, x, y);
-    if(_qsWin_redrawSwipePoint(win, trace, win->traces,
-          w * y + x, x, y, sc->pointCount - 5*(INT_MAX/12)))
-    {
-      setTraceColor(win, getXColor(win, r[i], g[i], b[i]));
-      xDrawPoint(win, x, y);
-      // _qsWin_drawPoints(win); will get called later
-    }
-    sc->next = NULL;
-
-    if(!next)
-    {
-      // We have swiped the whole list.
-      swipe->start = swipe->end = NULL;
-      swipe->lastValueAdded = -1;
-      return;
-    }
-
-    sc = next;
-    y = (sc - surface)/w;
-    x = (sc - surface) - y*w;
-  }
+  // Swipe the older laps from the columns up to xEnd.
+  for(x = swipe->eraseX; x <= xEnd; ++x)
+    if(swipe->column[x].len && lap - swipe->column[x].lap > 0)
+      _qsWin_swipeColumn(win, trace, swipe, x);
 
-  swipe->start = sc;
+  if(xEnd >= swipe->eraseX)
+    swipe->eraseX = xEnd + 1;
 }
 
 static inline
-void bumpCounters(struct QsWin *win, struct QsSwipe *swipe,
-    struct QsSwipeColor *sc, int x)
+void bumpCounters(struct QsWin *win, struct QsSwipe *swipe, int x)
 {
-  swipe->pointCount = ++win->swipePointCount;
-  if(sc) sc->pointCount = swipe->pointCount;
+  ++win->swipePointCount;
 
   if(x < swipe->lastValueAdded)
-    swipe->lapCount = swipe->pointCount;
+    ++swipe->lap;
 
   swipe->lastValueAdded = x;
 }
@@ -325,25 +321,18 @@ void _qsWin_unfreeze(struct QsWin *win)
     if(trace->swipe)
     {
 #if 1
-      if(trace->swipe->freezeLapCount > 2)
+      if(trace->swipe->freezeLapCount > 2 && trace->swipe->column)
         // We need to swipe the whole thing.
-        _qsWin_swipeRemove(win, trace, trace->swipe, win->width - 1);
+        _qsWin_swipeRemove(win, trace, trace->swipe, trace->swipe->width - 1);
 #endif
       trace->swipe->freezeLapCount = 0;
     }
   }
 }
 
-// This keeps counters from becoming invalid, even when the counters
-// may have overflowed a few times.  We just need the counters
-// to increment a little past the current trace counters if it's
-// frozen a long time.  This counting stuff will work correctly
-// forever so long as win->swipePointCount does not advance more
-// than about half of INT_MAX in a 3 (or so) trace laps.
-// How much depends on the number of traces and their point plot rates.
-// Calculating difference of counters works when the counters
-// overflow, so long as the differences are not greater than
-// around INT_MAX/2.
+// This keeps the lap counter going when the display is frozen.
+// We just need the lap to go a little past the current lap if it's
+// frozen a long time, so that all the old columns get swiped.
 static inline
 void _qsWin_swipeAddFrozenPoint(struct QsWin *win,
     struct QsTrace *trace, struct QsSwipe *swipe, int x)
@@ -352,7 +341,7 @@ void _qsWin_swipeAddFrozenPoint(struct QsWin *win,
   {
     if(swipe->lastValueAdded < x)
       ++swipe->freezeLapCount;
-    bumpCounters(win, swipe, NULL, x);
+    bumpCounters(win, swipe, x);
   }
 }
 
@@ -365,51 +354,35 @@ void _qsWin_swipeAddPoint(struct QsWin *win, struct QsTrace *trace,
 {
   QS_ASSERT(win);
   QS_ASSERT(trace && trace->swipe && trace->swipe == swipe);
-  QS_ASSERT(swipe && swipe->surface);
+  QS_ASSERT(swipe && swipe->column);
+  QS_ASSERT(x >= 0 && x < swipe->width);
+
+  bumpCounters(win, swipe, x);
 
   if(y < 0 || y >= win->height)
-  {
-    bumpCounters(win, swipe, NULL, x);
     return; // we can't draw it
-  }
 
-  struct QsSwipeColor *sc;
-  sc = swipe->surface + win->width * y + x;
+  struct QsSwipeColumn *col;
+  col = swipe->column + x;
 
-  if(sc->next || sc == swipe->end)
+  if(col->lap != swipe->lap)
   {
-    // It's already marked.  The trace must
-    // be dense in pixels; going up and down
-    // in Y at one X value.
-#ifdef QS_DEBUG
-    QS_ASSERT(sc->next || (sc == swipe->end && !sc->next));
-    if(swipe->lastValueAdded != x)
-    {
-      QS_SPEW("swipe->lastValueAdded != x\n"
-        "swipe->lastValueAdded=%d x=%d y=%d\n"
-        "I suspect it is to do with rounding float"
-        " x values to ints giving a decreasing int value.\n",
-        swipe->lastValueAdded, x, y);
-      //QS_ASSERT(0);
-    }
-#endif
-    return;
+    // It has rows from an older lap that did not get swiped yet.
+    if(col->len)
+      _qsWin_swipeColumn(win, trace, swipe, x);
+    col->lap = swipe->lap;
   }
-  // It's not in the list.
 
-  // Now put it at the end of the list
-  if(!swipe->start)
-  {
-    QS_ASSERT(!swipe->end);
-    swipe->start = sc;
-  }
-  else if(swipe->end)
-    swipe->end->next = sc;
-  swipe->end = sc;
-  sc->next = NULL;
+  col->stamp = win->swipePointCount;
+  win->swipeTop[win->width * y + x] = swipe->id;
 
-  bumpCounters(win, swipe, sc, x);
+  if(col->len && col->row[col->len - 1] == y)
+    // The trace must be dense in pixels; going up and down in
+    // Y at one X value.
+    return;
 
-  QS_ASSERT(x >= swipe->lastValueAdded || x < swipe->xMid);
-}
+  if(col->len == col->alloc)
+    _qsSwipe_growColumn(col, win->height);
 
+  col->row[col->len++] = y;
+}
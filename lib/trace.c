@@ -3,6 +3,7 @@
  * GNU General Public License version 3
  */
 #include <math.h>
+#include <stdlib.h>
 #include <inttypes.h>
 #include <X11/Xlib.h>
 #include <string.h>
@@ -21,11 +22,10 @@
 #include "iterator.h"
 #include "trace.h"
 #include "trace_priv.h"
+#include "trace_transform_priv.h"
 #include "swipe_priv.h"
 #include "win.h"
 
-#define SMALL 0.01F
-
 
 #define SKIP(x, y)    (isnan(x) || isnan(y))
 #define NSKIP(x, y)   (!isnan(x) && !isnan(y))
@@ -69,17 +69,60 @@ int Round(float x)
  * the pixels in the same order as their time so that beam trace fading
  * and/or beam trace swiping can keep ordered listed of aging pixels. */
 
-/* TODO: add line drawing with one point outside of the view port */
 /* TODO: interpolate the fade time between the time at the two ends
  * of the line, passing in two fade times. But the gradient in the
  * color may use more system resources */
 
-// We don't like wasting time dereferencing pointers again
-// and again, so we are passing win, trace, and swipe, when
-// the minimum needed would be trace.
+// Number of pixels in a line that we hand to the fade and swipe
+// drawing at a time.
+#define RUN_LEN  128
+
+// Liang-Barsky clipping of the line (x1,y1) (x2,y2) to
+// min <= v < max in one coordinate v, where v1 is the v value
+// at (x1,y1) and dv = v2 - v1.  Returns false if the line is culled.
+static inline
+bool clipT(float v1, float dv, float min, float max,
+    float *tMin, float *tMax)
+{
+  if(dv == 0.0F)
+    return (v1 >= min && v1 < max);
+
+  float ta, tb;
+  ta = (min - v1)/dv;
+  tb = (max - v1)/dv;
+  if(ta > tb)
+  {
+    float f;
+    f = ta;
+    ta = tb;
+    tb = f;
+  }
+  if(ta > *tMin)
+    *tMin = ta;
+  if(tb < *tMax)
+    *tMax = tb;
+  return (*tMin <= *tMax);
+}
+
+static inline
+void _qsWin_drawRun(struct QsWin *win,
+    struct QsTrace *trace, struct QsSwipe *swipe,
+    XPoint *run, int n, float r, float g, float b,
+    long double t)
+{
+  if(swipe)
+  {
+    int i;
+    for(i = 0; i < n; ++i)
+      _qsWin_swipeAddPoint(win, trace, swipe, run[i].x, run[i].y);
+  }
+  _qsWin_drawTracePoints(win, run, n, r, g, b, t);
+}
 
 /* This is the simplest line drawing method with no anti-aliasing.
- * Pretty much what X11 does in XDrawLine() */
+ * Pretty much what X11 does in XDrawLine().  It's an integer
+ * Bresenham line after clipping the float end points to the
+ * view port, so each pixel in the line is drawn just once. */
 static
 void _qsWin_drawLine(struct QsWin *win,
     struct QsTrace *trace, struct QsSwipe *swipe,
@@ -88,208 +131,142 @@ void _qsWin_drawLine(struct QsWin *win,
     long double t)
 {
   QS_ASSERT(win);
-  
+
+  /* We have no time for anti-aliasing.  It's not just
+   * this drawing time, we will have to fade any
+   * pixels that we add and anti-aliasing doubles or
+   * triples the number of pixels in a line, not to
+   * mention the increase in colors.  So maybe with
+   * a faster computer we could consider it.
+   *
+   * TODO: Add anti-aliasing as an option, that is
+   * off by default. */
+
+  if(!isfinite(x1) || !isfinite(y1) || !isfinite(x2) || !isfinite(y2))
+    // An inf end point makes NAN clip values, and we can't round
+    // those.  A source that blows up gets no line.
+    return;
+
   int w, h;
   w = win->width;
   h = win->height;
 
-  float dy;
-  dy = fabsf(y2 - y1);
-
-  if(fabs(x2 - x1) > SMALL && dy > SMALL)
+  if(x2 < x1)
   {
-    /* The line is not close to vertical or horizontal line */
-    float slope, a, x, k;
-    slope = (y2 -y1)/(x2 - x1);
-    a = y2 - slope * x2;
-
-    int prevX, prevY, ix, iy;
-
-    if(x2 < x1)
-    {
-      /* switch the order */
-      float f;
-      f = x1;
-      x1 = x2;
-      x2 = f;
-      f = y1;
-      y1 = y2;
-      y2 = f;
-    }
+    /* switch the order so we go with increasing x,
+     * which the swipe needs */
+    float f;
+    f = x1;
+    x1 = x2;
+    x2 = f;
+    f = y1;
+    y1 = y2;
+    y2 = f;
+  }
 
-    /* We have no time for anti-aliasing.  It's not just
-     * this drawing time, we will have to fade any
-     * pixels that we add and anti-aliasing doubles or
-     * triples the number of pixels in a line, not to
-     * mention the increase in colors.  So maybe with
-     * a faster computer we could consider it.
-     *
-     * TODO: Add anti-aliasing as an option, that is
-     * off by default.
-     *
-     * equation of the line is:  y = slope * x + a
-     *
-     * We go along the line a distance of 1 for each point
-     * which is a x distance of cosine of the angle and
-     * a y distance of sine of the angle.  slope is the
-     * tangent of the angle.
-     *
-     * Do some trigonometry...
-     * So x changes by cosine of the angle which is (k):
-     */
-    k = 1.0F/sqrtf(1.0F + slope * slope);
-
-    prevX = INT_MIN;
-    prevY = INT_MIN;
-
-    // Check for Cull
-    if(x2 >= w)
-      x2 = w - 1;
-    if(x1 < 0.0F)
-      x1 = 0.0F;
-
-    if(x1 > x2)
-      // culled all the line due to x values.
-      // This will not catch all culls due to
-      // rounding to int.
-      return;
+  float dx, dy, tMin = 0.0F, tMax = 1.0F;
+  dx = x2 - x1;
+  dy = y2 - y1;
 
-    if(swipe)
-    {
-      // Dam floating point round off requires we cull check
-      // yet again.
-      ix = Round(x2);
-      if(ix >= w)
-      {
-        if(Round(x1) < w)
-          ix = w - 1;
-        else
-          return; // culled due to x values
-      }
+  // Clip in x to the same view port as _qsTrace_code() uses, so
+  // that the x values round to [0, w-1]
+  if(!clipT(x1, dx, -0.5F, w - 0.5F, &tMin, &tMax))
+    return; // culled due to x values
 
-      // This will swipe away all of points older than
-      // and equal to the ones with x value ix
-      _qsWin_swipeRemove(win, trace, swipe, ix);
-    }
-    
-    // We let the point drawing cull in the y
-    // so X swipe works correctly.
+  int ixEnd = 0;
 
-    for(x=x1;x<x2;x+=k)
-    {
-      ix = Round(x);
-      iy = Round(x*slope + a);
-      /* We do not draw the same point twice.  That
-       * will happen lots if the angle is near 45 degrees
-       * and the pixels close to the line, if not for
-       * this check.*/
-      if((prevX != ix || prevY != iy) && ix >= 0 && ix < w)
-        _qsWin_drawPoint(win, trace, swipe, w, h,
-            prevX = ix, prevY = iy,
-            r, g, b, t);
-    }
-    /* See if we got the last point, if not draw it. */
-    ix = Round(x2);
-    iy = Round(x2*slope + a);
-    if((prevX != ix || prevY != iy) && ix >= 0 && ix < w)
-      _qsWin_drawPoint(win, trace, swipe, w, h,
-          ix, iy, r, g, b, t);
-  }
-  else if(dy > SMALL) /* fabs(x2 - x1) <= SMALL */
+  if(swipe)
   {
-    /* Line is close to vertical */
-    int y, ymin, ymax, x;
-    if(y2 > y1)
-    {
-      ymax = Round(y2);
-      ymin = Round(y1);
-    }
-    else
-    {
-      ymax = Round(y1);
-      ymin = Round(y2);
-    }
-    x = Round((x2 + x1)/2.0F);
-
-    if(x >= w || x < 0)
-      // Culled
-      return;
-
-    // We must let qsWin_drawPoint() cull due to y
-    // so X swipe works correctly.
-
-    if(ymin < 0)
-      ymin = 0;
-    if(ymax >= h)
-      ymax = h - 1;
+    // This will swipe away all of points older than
+    // and equal to the ones with x value ixEnd
+    ixEnd = (tMax < 1.0F)?Round(x1 + tMax*dx):Round(x2);
+    if(ixEnd >= w) ixEnd = w - 1;
+    else if(ixEnd < 0) ixEnd = 0;
+    _qsWin_swipeRemove(win, trace, swipe, ixEnd);
+  }
 
+  // Clip in y
+  if(!clipT(y1, dy, -0.5F, h - 0.5F, &tMin, &tMax))
+  {
+    // culled due to y, but need to keep trace lap count
+    // up to date.
     if(swipe)
-      // We may not draw, but we still need to
-      // swipe old points at x and older.
-      _qsWin_swipeRemove(win, trace, swipe, x);
-
-    if(ymin > ymax)
-    {
-      // culled due to y, but need to keep trace lap count
-      // up to date.
-      if(swipe)
-        _qsWin_swipeAddPoint(win, trace, swipe, x, ymin);
+      _qsWin_swipeAddPoint(win, trace, swipe, ixEnd, -1);
+    return;
+  }
 
-      return;
-    }
+  int ix, iy, ix2, iy2, sy, err, e2, adx, ady, n;
+  XPoint run[RUN_LEN];
 
-    for(y=ymin;y<=ymax;++y)
-      _qsWin_drawPoint(win, trace, swipe, w, h,
-          x, y, r, g, b, t);
+  // End points that are not clipped are rounded as they are, the
+  // same as the points are, and not from x1 + 1.0F*dx which can be
+  // off by a float round off, so that a line ends on the same pixel
+  // as a point drawn there.
+  if(tMin > 0.0F)
+  {
+    ix = Round(x1 + tMin*dx);
+    iy = Round(y1 + tMin*dy);
+  }
+  else
+  {
+    ix = Round(x1);
+    iy = Round(y1);
+  }
+  if(tMax < 1.0F)
+  {
+    ix2 = Round(x1 + tMax*dx);
+    iy2 = Round(y1 + tMax*dy);
   }
-  else /* fabs(y2 - y1) <= SMALL */
+  else
   {
-    /* The line is close to horizontal or just a single point */
-    int x, xmin, xmax, y;
+    ix2 = Round(x2);
+    iy2 = Round(y2);
+  }
 
-    if(x2 > x1)
-    {
-      /* switch the order */
-      xmin = Round(x1);
-      xmax = Round(x2);
-    }
-    else
+  // Float round off, and Round(-0.5F) being -1 at the clip edge,
+  // may put us one pixel out.
+  if(ix < 0) ix = 0;
+  if(ix2 >= w) ix2 = w - 1;
+  if(ix2 < ix) ix2 = ix;
+  if(iy < 0) iy = 0;
+  else if(iy >= h) iy = h - 1;
+  if(iy2 < 0) iy2 = 0;
+  else if(iy2 >= h) iy2 = h - 1;
+
+  adx = ix2 - ix;
+  ady = abs(iy2 - iy);
+  sy = (iy < iy2)?1:-1;
+  err = adx - ady;
+  n = 0;
+
+  while(true)
+  {
+    run[n].x = ix;
+    run[n].y = iy;
+    if(++n == RUN_LEN)
     {
-      xmin = Round(x2);
-      xmax = Round(x1);
+      _qsWin_drawRun(win, trace, swipe, run, n, r, g, b, t);
+      n = 0;
     }
 
-    y = Round((y2 + y1)/2.0F);
-
-    // Culling
-    if(xmax >= w)
-      xmax = w - 1;
-    if(xmin < 0)
-      xmin = 0;
-
-    if(xmin > xmax)
-      // Culled due to x
-      return;
-
-    if(swipe)
-      // We may not draw, but we still need to
-      // swipe old points at x and older.
-      _qsWin_swipeRemove(win, trace, swipe, xmax);
+    if(ix == ix2 && iy == iy2)
+      break;
 
-    if(y < 0 || y >= h)
+    e2 = 2*err;
+    if(e2 > -ady)
     {
-      // culled due to y, but need to keep trace lap count
-      // up to date by passing xmax to this.
-      if(swipe)
-        _qsWin_swipeAddPoint(win, trace, swipe, xmax, y);
-      
-      return;
+      err -= ady;
+      ++ix;
+    }
+    if(e2 < adx)
+    {
+      err += adx;
+      iy += sy;
     }
-
-    for(x=xmin;x<=xmax;++x)
-      _qsWin_drawPoint(win, trace, swipe, w, h,
-          x, y, r, g, b, t);
   }
+
+  if(n)
+    _qsWin_drawRun(win, trace, swipe, run, n, r, g, b, t);
 }
 
 size_t _qsTrace_iconText(char *buf, size_t len, struct QsTrace *trace)
@@ -329,12 +306,27 @@ void makeAdjuster(struct  QsTrace *trace, const char *text,
       (void (*)(void *)) _qsTrace_cb_rescale, trace);
 }
 
+static
+void _qsTrace_cb_peak(struct  QsTrace *trace)
+{
+  qsTrace_setPeakDetect(trace, trace->peak);
+}
+
 static
 void _qsTrace_cb_swipe(struct  QsTrace *trace)
 {
   qsTrace_setSwipeX(trace, trace->isSwipe);
 }
 
+void qsTrace_setPeakDetect(struct QsTrace *trace, bool on)
+{
+  QS_ASSERT(trace && trace->win);
+  _qsWin_renderPause(trace->win);
+  trace->peak = on;
+  trace->peakCol = INT_MIN;
+  _qsWin_renderResume(trace->win);
+}
+
 struct QsTrace *qsTrace_create(struct QsWin *win,
       struct QsSource *xs, int xChannelNum,
       struct QsSource *ys, int yChannelNum,
@@ -375,10 +367,13 @@ struct QsTrace *qsTrace_create(struct QsWin *win,
   trace->prevY = NAN;
   trace->prevPrevX = NAN;
   trace->prevPrevY = NAN;
+  trace->peakCol = INT_MIN;
   trace->id = win->traceCount++;
   _qsTrace_scale(trace);
 
+  _qsWin_renderPause(win);
   win->traces = g_slist_prepend(win->traces, trace);
+  _qsWin_renderResume(win);
 
 
   char desc[64];
@@ -389,7 +384,8 @@ struct QsTrace *qsTrace_create(struct QsWin *win,
         void *iconData)) _qsTrace_iconText;
   group->iconData = trace;
 
-  if(qsSource_isSwipable(xs))
+  // The OpenGL back end does not do swipe.
+  if(qsSource_isSwipable(xs) && !win->gl)
   {
     snprintf(desc, 64, "trace%d: Swipe", trace->id);
     qsAdjusterBool_create(&trace->win->adjusters, desc,
@@ -400,6 +396,10 @@ struct QsTrace *qsTrace_create(struct QsWin *win,
   qsAdjusterBool_create(&trace->win->adjusters, desc,
       &trace->lines, NULL, NULL);
 
+  snprintf(desc, 64, "trace%d: Peak Detect", trace->id);
+  qsAdjusterBool_create(&trace->win->adjusters, desc,
+      &trace->peak, (void (*)(void *)) _qsTrace_cb_peak, trace);
+
   makeAdjuster(trace, "X Scale", &trace->xScale,
     trace->xScale/100.0, /* min */ trace->xScale*100.0 /* max */);
 
@@ -442,14 +442,89 @@ void _qsTrace_scale(struct QsTrace *trace)
   trace->prevY = NAN;
   trace->prevPrevX = NAN;
   trace->prevPrevY = NAN;
+  trace->peakCol = INT_MIN;
 
-  if(trace->swipe)
+  if(trace->swipe && !_qsTrace_resampleSwipe(trace))
   {
+    // We can't keep the swiped pixels.
     _qsTrace_reallocSwipe(trace);
     _qsTrace_initSwipe(trace);
   }
 }
 
+// Draw the peak detect vertical line for the current pixel column.
+static inline
+void _qsTrace_peakFlush(struct QsTrace *trace, struct QsSwipe *swipe,
+    float r, float g, float b)
+{
+  if(trace->peakCol == INT_MIN || trace->peakDrawn)
+    return;
+
+  _qsWin_drawLine(trace->win, trace, swipe,
+      trace->peakX, trace->peakMin, trace->peakX, trace->peakMax,
+      r, g, b, trace->peakT);
+  trace->peakDrawn = true;
+}
+
+// Peak detect drawing of one point in lines mode.
+// x and y are in pixels with code c from _qsTrace_transform().
+// prevX, prevY, and prevCode are the values before this one.
+static inline
+void _qsTrace_peakPoint(struct QsTrace *trace, struct QsSwipe *swipe,
+    float prevX, float prevY, uint8_t prevCode,
+    float x, float y, uint8_t c, int cullMask,
+    float r, float g, float b, long double t)
+{
+  if(c & QS_PEN_LIFT)
+  {
+    // The pen is lifted so we finish the column.
+    _qsTrace_peakFlush(trace, swipe, r, g, b);
+    trace->peakCol = INT_MIN;
+    return;
+  }
+
+  int col;
+  if(c & QS_CULL_X)
+    // All values off the view port on one side
+    // are put in one column.
+    col = (c & QS_CULL_LEFT)?-1:trace->win->width;
+  else
+    col = Round(x);
+
+  if(col == trace->peakCol)
+  {
+    if(y < trace->peakMin)
+    {
+      trace->peakMin = y;
+      trace->peakDrawn = false;
+    }
+    else if(y > trace->peakMax)
+    {
+      trace->peakMax = y;
+      trace->peakDrawn = false;
+    }
+    trace->peakT = t;
+    return;
+  }
+
+  if(trace->peakCol != INT_MIN)
+  {
+    _qsTrace_peakFlush(trace, swipe, r, g, b);
+    // Connect the last value in the old column to the
+    // first value in this new column.
+    if(!(c & prevCode & cullMask) && (x != prevX || y != prevY))
+      _qsWin_drawLine(trace->win, trace, swipe,
+          prevX, prevY, x, y, r, g, b, t);
+  }
+
+  // Start a new column
+  trace->peakCol = col;
+  trace->peakX = x;
+  trace->peakMin = trace->peakMax = y;
+  trace->peakT = t;
+  trace->peakDrawn = false;
+}
+
 // This drawing function assumes that the x source and the y source
 // have the same time values, so no temporal interpolation is needed.
 static inline
@@ -462,12 +537,21 @@ void _qsTrace_drawSameXY(struct QsTrace *trace,
   struct QsWin *win;
   win = trace->win;
   float prevX, prevY, x, y, r, g, b;
-  long double time;
+  int w, h, k;
+  uint8_t prevCode;
   struct QsIterator2 *it;
+  struct QsIterator2Span span;
+  // The values transformed to pixel coordinates
+  float px[QS_TRACE_BLOCK], py[QS_TRACE_BLOCK];
+  uint8_t code[QS_TRACE_BLOCK];
+
   it = trace->it;
+  w = win->width;
+  h = win->height;
 
   prevX = trace->prevX;
   prevY = trace->prevY;
+  prevCode = _qsTrace_code(prevX, prevY, w, h);
 
   r = trace->red;
   g = trace->green;
@@ -479,76 +563,116 @@ void _qsTrace_drawSameXY(struct QsTrace *trace,
     prevPrevX = trace->prevPrevX;
     prevPrevY = trace->prevPrevY;
 
-    while(qsIterator2_get(it, &x, &y, &time))
-    {
-      x = x*trace->xScalePix + trace->xShiftPix;
-      y = y*trace->yScalePix + trace->yShiftPix;
+    // With swipe we cannot cull lines that are only off the top or
+    // bottom, because the swipe needs to keep its lap count going.
+    int cullMask;
+    cullMask = swipe?QS_CULL_X:QS_CULL_MASK;
 
-      /* The value NAN [SKIP()] has the effect of lifting
-       * the pen and braking the line. */
+    while(qsIterator2_getSpan(it, &span, QS_TRACE_BLOCK))
+    {
+      _qsTrace_transform(span.x0, span.stride0, span.x1, span.stride1,
+          span.len, trace->xScalePix, trace->xShiftPix,
+          trace->yScalePix, trace->yShiftPix, w, h, px, py, code);
 
-      if(NSKIP(x,y) && NSKIP(prevX,prevY)
-          && (x != prevX || y != prevY))
+      if(trace->peak)
       {
-        _qsWin_drawLine(win, trace, swipe,
-          prevX, prevY, x, y, r, g, b, time);
+        for(k = 0; k < span.len; ++k)
+        {
+          _qsTrace_peakPoint(trace, swipe, prevX, prevY, prevCode,
+              px[k], py[k], code[k], cullMask, r, g, b, span.t[k]);
+          prevPrevX = prevX;
+          prevPrevY = prevY;
+          prevX = px[k];
+          prevY = py[k];
+          prevCode = code[k];
+        }
+        continue;
       }
-      else if(SKIP(prevPrevX,prevPrevY) && NSKIP(prevX,prevY) && (SKIP(x,y)) &&
-          Round(prevX) >= 0 && Round(prevX) < win->width)
+
+      for(k = 0; k < span.len; ++k)
       {
-        // In this odd case there is a x,y point with a NAN
-        // on either side should at least draw a point.
-        // This happened to me without this code and
-        // nothing was drawn.
-        if(swipe)
-            _qsWin_swipeRemove(win, trace, swipe, Round(prevX));
-        // This must and will cull for y
-        _qsWin_drawPoint(win, trace, swipe, win->width, win->height,
-              Round(prevX), Round(prevY), r, g, b, time);
-      }
+        uint8_t c;
+        x = px[k];
+        y = py[k];
+        c = code[k];
+
+        /* The value NAN [QS_PEN_LIFT] has the effect of lifting
+         * the pen and braking the line. */
+
+        if(!((c | prevCode) & QS_PEN_LIFT)
+            && (x != prevX || y != prevY))
+        {
+          if(!(c & prevCode & cullMask))
+            _qsWin_drawLine(win, trace, swipe,
+              prevX, prevY, x, y, r, g, b, span.t[k]);
+        }
+        else if(SKIP(prevPrevX,prevPrevY) && !(prevCode & QS_PEN_LIFT) &&
+            (c & QS_PEN_LIFT) && !(prevCode & QS_CULL_X))
+        {
+          // In this odd case there is a x,y point with a NAN
+          // on either side should at least draw a point.
+          // This happened to me without this code and
+          // nothing was drawn.
+          if(swipe)
+              _qsWin_swipeRemove(win, trace, swipe, Round(prevX));
+          // This must and will cull for y
+          _qsWin_drawPoint(win, trace, swipe, w, h,
+                Round(prevX), Round(prevY), r, g, b, span.t[k]);
+        }
 
-      prevPrevX = prevX;
-      prevPrevY = prevY;
+        prevPrevX = prevX;
+        prevPrevY = prevY;
 
-      prevX = x;
-      prevY = y;
+        prevX = x;
+        prevY = y;
+        prevCode = c;
+      }
     }
 
     trace->prevPrevX = prevPrevX;
     trace->prevPrevY = prevPrevY;
 
+    if(trace->peak)
+      // Show what we have so far in the current column.
+      // It will get redrawn if it grows with more values.
+      _qsTrace_peakFlush(trace, swipe, r, g, b);
   }
   else // just points
   {
-    while(qsIterator2_get(it, &x, &y, &time))
+    while(qsIterator2_getSpan(it, &span, QS_TRACE_BLOCK))
     {
+      _qsTrace_transform(span.x0, span.stride0, span.x1, span.stride1,
+          span.len, trace->xScalePix, trace->xShiftPix,
+          trace->yScalePix, trace->yShiftPix, w, h, px, py, code);
 
-      if(NSKIP(x,y) && (x != prevX || y != prevY))
+      for(k = 0; k < span.len; ++k)
       {
-        int ix, iy;
-        ix = x = x*trace->xScalePix + trace->xShiftPix;
-        iy = y = y*trace->yScalePix + trace->yShiftPix;
- 
-        if(ix >= 0 && ix < win->width)
+        x = px[k];
+        y = py[k];
+
+        if(!(code[k] & (QS_PEN_LIFT | QS_CULL_X)) &&
+            (x != prevX || y != prevY))
         {
+          int ix;
+          ix = Round(x);
           if(swipe)
             _qsWin_swipeRemove(win, trace, swipe, ix);
           // This must and will cull for y
-          _qsWin_drawPoint(win, trace, swipe,
-              win->width, win->height,
-              ix, iy, r, g, b, time);
+          _qsWin_drawPoint(win, trace, swipe, w, h,
+              ix, Round(y), r, g, b, span.t[k]);
         }
-      }
 
-      prevX = x;
-      prevY = y;
+        prevX = x;
+        prevY = y;
+      }
     }
   }
 
   trace->prevX = prevX;
   trace->prevY = prevY;
 
-  _qsWin_drawPoints(win); // flush points
+  // The points get drawn in _qsWin_postTraceDraw(), after all the
+  // traces in the window add theirs.
 }
 
 void _qsTrace_draw(struct QsTrace *trace, long double t)
@@ -594,6 +718,7 @@ void _qsTrace_draw(struct QsTrace *trace, long double t)
      * resume we do not draw a line connecting
      * between two non-temporally-adjacent points. */
     trace->prevPrevX = trace->prevX = QS_LIFT;
+    trace->peakCol = INT_MIN;
     return;
   }
 
@@ -611,11 +736,16 @@ void qsTrace_destroy(struct QsTrace *trace)
   struct QsWin *win;
   win = trace->win;
 
+  // The render thread may not draw this trace while we take it apart.
+  _qsWin_renderPause(win);
+
   if(trace->swipe)
     _qsTrace_cleanupSwipe(trace);
 
   win->traces = g_slist_remove(win->traces, trace);
 
+  _qsWin_renderResume(win);
+
 
   // Now remove (or derefenence) the source adjusters from the QsWin
   // adjustersList if we can.  This may have been done in qsSource_destroy().
@@ -22,6 +22,13 @@ struct QsTrace *qsTrace_create(struct QsWin *win,
 extern
 void qsTrace_setSwipeX(struct QsTrace *trace, bool on);
 
+/* Peak detect, for lines, draws all values that land in the same
+ * pixel column as one vertical line from the min to the max value,
+ * like a hardware scope peak detect mode.  It's much faster for
+ * sweeps with many values per pixel column. */
+extern
+void qsTrace_setPeakDetect(struct QsTrace *trace, bool on);
+
 /* destroying the QsWin will destroy the QsTrace unless
  * you call qsTrace_destroy() before you destroy the
  * QsWin. */
@@ -30,6 +30,15 @@ struct QsTrace
   float prevX, prevY; /* for line and point drawing */
   float prevPrevX, prevPrevY; /* for line drawing */
 
+  /* Peak detect: lines with values that land in the same pixel
+   * column are drawn as one vertical line from the min to the max
+   * value in that column.  peakCol is INT_MIN if we have no values
+   * in a column yet. */
+  bool peak, peakDrawn;
+  int peakCol;
+  float peakX, peakMin, peakMax;
+  long double peakT;
+
   /* Sources that cause this trace to draw.  We keep the option to have
    * more than one source trigger the draw.  Who are we to limit that? */
   GSList *drawSources;
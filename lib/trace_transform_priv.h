@@ -0,0 +1,166 @@
+/* Quickscope - a software oscilloscope
+ * Copyright (C) 2012-2014  Lance Arsenault
+ * GNU General Public License version 3
+ */
+
+// The first stage of drawing a trace: transform a block of source
+// values to pixel coordinates, and make a code for each point that
+// tells if the pen is lifted (NAN) and what side of the view port the
+// point is off of, like in Cohen-Sutherland line clipping.  A line
+// between two points is culled if both points are off the same side,
+// (code0 & code1 & QS_CULL_MASK) != 0.
+//
+// We use AVX2 or SSE2 if the compiler is building for it, as in
+// CFLAGS="-O2 -mavx2", otherwise we use plain C.
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#elif defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
+// Number of points we transform at a time.
+#define QS_TRACE_BLOCK    256
+
+#define QS_CULL_LEFT      (1<<0)
+#define QS_CULL_RIGHT     (1<<1)
+#define QS_CULL_TOP       (1<<2)
+#define QS_CULL_BOTTOM    (1<<3)
+#define QS_PEN_LIFT       (1<<4)
+
+#define QS_CULL_X         (QS_CULL_LEFT | QS_CULL_RIGHT)
+#define QS_CULL_MASK      (QS_CULL_X | QS_CULL_TOP | QS_CULL_BOTTOM)
+
+
+static inline
+uint8_t _qsTrace_code(float x, float y, int w, int h)
+{
+  uint8_t c = 0;
+  // <= because Round(-0.5F) is -1.
+  if(x <= -0.5F) c |= QS_CULL_LEFT;
+  if(x >= w - 0.5F) c |= QS_CULL_RIGHT;
+  if(y <= -0.5F) c |= QS_CULL_TOP;
+  if(y >= h - 0.5F) c |= QS_CULL_BOTTOM;
+  if(isnan(x) || isnan(y)) c |= QS_PEN_LIFT;
+  return c;
+}
+
+// px, py, and code must have at least n elements and n must be
+// less than or equal to QS_TRACE_BLOCK.  px and py may not be x and y.
+// A point is in the view port if it rounds to a pixel in
+// [0, w-1] x [0, h-1].
+static inline
+void _qsTrace_transform(const float *x, int xStride,
+    const float *y, int yStride, int n,
+    float xScale, float xShift, float yScale, float yShift,
+    int w, int h,
+    float *px, float *py, uint8_t *code)
+{
+  QS_ASSERT(n <= QS_TRACE_BLOCK);
+
+  int k = 0;
+
+  if(xStride != 1 || yStride != 1)
+  {
+    // Gather into the contiguous output arrays, and then
+    // transform in place.
+    for(k = 0; k < n; ++k)
+    {
+      px[k] = x[k*xStride];
+      py[k] = y[k*yStride];
+    }
+    x = px;
+    y = py;
+    k = 0;
+  }
+
+#if defined(__AVX2__)
+  {
+    const __m256 XS = _mm256_set1_ps(xScale), XSH = _mm256_set1_ps(xShift),
+      YS = _mm256_set1_ps(yScale), YSH = _mm256_set1_ps(yShift),
+      LO = _mm256_set1_ps(-0.5F), XHI = _mm256_set1_ps(w - 0.5F),
+      YHI = _mm256_set1_ps(h - 0.5F);
+    const __m256i ONE = _mm256_set1_epi32(QS_CULL_LEFT),
+      TWO = _mm256_set1_epi32(QS_CULL_RIGHT),
+      FOUR = _mm256_set1_epi32(QS_CULL_TOP),
+      EIGHT = _mm256_set1_epi32(QS_CULL_BOTTOM),
+      LIFT = _mm256_set1_epi32(QS_PEN_LIFT);
+
+    for(; k + 8 <= n; k += 8)
+    {
+      __m256 X, Y;
+      __m256i c;
+      X = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&x[k]), XS), XSH);
+      Y = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&y[k]), YS), YSH);
+      _mm256_storeu_ps(&px[k], X);
+      _mm256_storeu_ps(&py[k], Y);
+
+      c = _mm256_and_si256(_mm256_castps_si256(
+            _mm256_cmp_ps(X, LO, _CMP_LE_OQ)), ONE);
+      c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(
+            _mm256_cmp_ps(X, XHI, _CMP_GE_OQ)), TWO));
+      c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(
+            _mm256_cmp_ps(Y, LO, _CMP_LE_OQ)), FOUR));
+      c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(
+            _mm256_cmp_ps(Y, YHI, _CMP_GE_OQ)), EIGHT));
+      c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(
+            _mm256_or_ps(_mm256_cmp_ps(X, X, _CMP_UNORD_Q),
+              _mm256_cmp_ps(Y, Y, _CMP_UNORD_Q))), LIFT));
+
+      // 8 x 32 bit codes to 8 bytes
+      __m128i c16;
+      c16 = _mm_packs_epi32(_mm256_castsi256_si128(c),
+          _mm256_extracti128_si256(c, 1));
+      c16 = _mm_packus_epi16(c16, c16);
+      _mm_storel_epi64((__m128i *) &code[k], c16);
+    }
+  }
+#elif defined(__SSE2__)
+  {
+    const __m128 XS = _mm_set1_ps(xScale), XSH = _mm_set1_ps(xShift),
+      YS = _mm_set1_ps(yScale), YSH = _mm_set1_ps(yShift),
+      LO = _mm_set1_ps(-0.5F), XHI = _mm_set1_ps(w - 0.5F),
+      YHI = _mm_set1_ps(h - 0.5F);
+    const __m128i ONE = _mm_set1_epi32(QS_CULL_LEFT),
+      TWO = _mm_set1_epi32(QS_CULL_RIGHT),
+      FOUR = _mm_set1_epi32(QS_CULL_TOP),
+      EIGHT = _mm_set1_epi32(QS_CULL_BOTTOM),
+      LIFT = _mm_set1_epi32(QS_PEN_LIFT);
+
+    for(; k + 4 <= n; k += 4)
+    {
+      __m128 X, Y;
+      __m128i c;
+      X = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&x[k]), XS), XSH);
+      Y = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&y[k]), YS), YSH);
+      _mm_storeu_ps(&px[k], X);
+      _mm_storeu_ps(&py[k], Y);
+
+      c = _mm_and_si128(_mm_castps_si128(_mm_cmple_ps(X, LO)), ONE);
+      c = _mm_or_si128(c, _mm_and_si128(
+            _mm_castps_si128(_mm_cmpge_ps(X, XHI)), TWO));
+      c = _mm_or_si128(c, _mm_and_si128(
+            _mm_castps_si128(_mm_cmple_ps(Y, LO)), FOUR));
+      c = _mm_or_si128(c, _mm_and_si128(
+            _mm_castps_si128(_mm_cmpge_ps(Y, YHI)), EIGHT));
+      c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(
+            _mm_or_ps(_mm_cmpunord_ps(X, X), _mm_cmpunord_ps(Y, Y))), LIFT));
+
+      // 4 x 32 bit codes to 4 bytes
+      c = _mm_packs_epi32(c, c);
+      c = _mm_packus_epi16(c, c);
+      int32_t c4;
+      c4 = _mm_cvtsi128_si32(c);
+      memcpy(&code[k], &c4, 4);
+    }
+  }
+#endif
+
+  // The remainder, or all of it without SIMD.
+  for(; k < n; ++k)
+  {
+    px[k] = x[k]*xScale + xShift;
+    py[k] = y[k]*yScale + yShift;
+    code[k] = _qsTrace_code(px[k], py[k], w, h);
+  }
+}
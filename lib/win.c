@@ -46,6 +46,18 @@ void _qsWin_changeFadePeriod(struct QsWin *win)
   win->fadeMaxDrawPeriod = win->fadePeriod/20;
   if(win->fadeMaxDrawPeriod < 1.0F/60.0F)
     win->fadeMaxDrawPeriod = 1.0F/60.0F;
+  // The fade queue time ticks depend on the fade period and delay.
+  _qsWin_fadeRebucket(win);
+}
+
+static
+void _qsWin_changeFadeEngine(struct QsWin *win)
+{
+  // The old engine's fading pixels are dropped, and
+  // _qsWin_reconfigure() makes the new engine.
+  if(win->fadeSurface)
+    _qsWin_fadeCleanup(win);
+  _qsWin_reconfigure(win);
 }
 
 static
@@ -122,7 +134,11 @@ struct QsWin *qsWin_create(void)
   win->tickG = qsApp->op_tickG * GMAX + 0.5F;
   win->tickB = qsApp->op_tickB * BMAX + 0.5F;
 
+#ifdef QS_GL
+  if(qsApp->op_doubleBuffer && !qsApp->op_gl)
+#else
   if(qsApp->op_doubleBuffer)
+#endif
     // use as a flag for now
     win->pixmap = (intptr_t) 1;
 
@@ -150,6 +166,7 @@ struct QsWin *qsWin_create(void)
   win->fadeDelay = qsApp->op_fadeDelay;
   _qsWin_changeFadePeriod(win);
   win->fade = qsApp->op_fade;
+  win->fadeEngine = qsApp->op_fadeEngine;
 
 
   win->hashTable = g_hash_table_new_full(g_int_hash,
@@ -185,7 +202,18 @@ struct QsWin *qsWin_create(void)
   qsAdjusterFloat_create(&win->adjusters,
       "Fade Delay", "sec", &win->fadeDelay,
       0.0F, /* min */ 10000.0F, /* max */
-      NULL, NULL);
+      (void (*)(void *)) _qsWin_changeFadePeriod,
+      win);
+  {
+    int engineValues[] = { QS_FADE_QUEUE, QS_FADE_PHOSPHOR,
+      QS_FADE_DENSITY };
+    const char *label[] = { "queue", "phosphor", "density" };
+
+    qsAdjusterSelector_create(&win->adjusters,
+      "Fade Engine", &win->fadeEngine,
+      engineValues, label, 3 /* num values */,
+      (void (*)(void *)) _qsWin_changeFadeEngine, win);
+  }
   qsAdjusterFloat_create(&win->adjusters,
       "X Grid Shift", "x width", &win->gridXWinOffset,
       -0.6, /* min */ 0.6, /* max */
@@ -228,6 +256,8 @@ void qsWin_destroy(struct QsWin *win)
   QS_ASSERT(win->da);
   QS_ASSERT(qsApp);
 
+  // Stop and join the render thread before we take the window apart.
+  _qsWin_renderDestroy(win);
 
   while(win->drawSyncs)
   {
@@ -243,14 +273,21 @@ void qsWin_destroy(struct QsWin *win)
   if(win->hashTable)
     g_hash_table_destroy(win->hashTable);
 
+#ifdef QS_GL
+  _qsWin_glDestroy(win);
+#endif
+  _qsWin_frameBufferDestroy(win);
   if(win->gc)
     XFreeGC(gdk_x11_get_default_xdisplay(), win->gc);
   if(win->pixmap && win->pixmap != (intptr_t) 1)
     XFreePixmap(win->dsp, win->pixmap);
-  if(win->fadeSurface)
-    g_free(win->fadeSurface);
-  if(win->points)
-    g_free(win->points);
+  _qsWin_fadeCleanup(win);
+  _qsWin_cleanupPointBins(win);
+  _qsWin_backgroundCacheCleanup(win);
+  if(win->swipeTop)
+    g_free(win->swipeTop);
+  if(win->bgPlane)
+    g_free(win->bgPlane);
   if(win->unitsXLabel)
     g_free(win->unitsXLabel);
   if(win->unitsYLabel)
@@ -1,6 +1,21 @@
 struct QsWin;
 struct QsTrace;
 
+/* How the trace pixels fade, qsApp->op_fadeEngine */
+enum QsFadeEngine
+{
+  /* Pixels are kept in time buckets, and fade linearly (or
+   * exponentially without LINEAR_FADE) after the fade delay. */
+  QS_FADE_QUEUE = 0,
+  /* Like a phosphor screen: each pixel has an intensity that decays
+   * exponentially and adds up when traces draw over it again. */
+  QS_FADE_PHOSPHOR,
+  /* Like a digital phosphor scope: we count the trace hits on each
+   * pixel and color pixels by hit count with a color ramp.  The
+   * counts decay with time.  The trace colors are not used. */
+  QS_FADE_DENSITY
+};
+
 extern
 struct QsWin *qsWin_create(void);
 extern
@@ -25,3 +40,24 @@ void qsWin_setYUnits(struct QsWin *win, const char *unitsLabel);
 extern
 struct QsWin *qsWin_getDefault(struct QsWin *win);
 
+
+/* File formats for qsWin_saveSnapshot() */
+enum QsSnapshotFormat
+{
+  /* A PNG file with the qsApp->op_savePNG_alpha and
+   * qsApp->op_savePNG_bgAlpha alphas, like the "Save PNG" menu. */
+  QS_SNAPSHOT_PNG = 0,
+  /* A binary PPM (P6) file.  It's just a short header and the raw
+   * 8 bit RGB pixels, so it's fast to write for logging. */
+  QS_SNAPSHOT_PPM
+};
+
+/* Saves an image of the drawing area to filename.  The image is made
+ * now, but the file is encoded and written by a worker thread so that
+ * this does not stall the drawing.  Snapshots are written in the
+ * order that they are made.  Returns true if the snapshot was queued,
+ * or false if the window is not drawn yet, is drawn with OpenGL, or
+ * too many snapshots are waiting to be written. */
+extern
+bool qsWin_saveSnapshot(struct QsWin *win, const char *filename,
+    enum QsSnapshotFormat format);
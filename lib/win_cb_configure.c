@@ -21,6 +21,49 @@
 #include "swipe_priv.h"
 
 
+// Get the shift and number of bits from a visual color mask.
+static inline
+void maskShift(unsigned long mask, int *shift, unsigned long *max)
+{
+  *shift = 0;
+  while(mask && !(mask & 01))
+  {
+    mask >>= 1;
+    ++*shift;
+  }
+  *max = mask;
+}
+
+// If the visual is TrueColor we make tables to compute the X11 pixel
+// values from r, g, b, so that getXColor() does not need to call
+// XAllocColor() and look up colors in a hash table.
+static
+void initColors(struct QsWin *win)
+{
+  Visual *visual;
+  visual = DefaultVisual(win->dsp, DefaultScreen(win->dsp));
+
+  win->trueColor = (visual->class == TrueColor);
+  if(!win->trueColor)
+    // PseudoColor and the like use the hash table.
+    return;
+
+  int i, shift;
+  unsigned long max;
+
+  maskShift(visual->red_mask, &shift, &max);
+  for(i = 0; i <= RMAX; ++i)
+    win->redPixel[i] = ((i * max + RMAX/2)/RMAX) << shift;
+
+  maskShift(visual->green_mask, &shift, &max);
+  for(i = 0; i <= GMAX; ++i)
+    win->greenPixel[i] = ((i * max + GMAX/2)/GMAX) << shift;
+
+  maskShift(visual->blue_mask, &shift, &max);
+  for(i = 0; i <= BMAX; ++i)
+    win->bluePixel[i] = ((i * max + BMAX/2)/BMAX) << shift;
+}
+
 /* For reconfiguring the drawing area when some parameters change
  * but not the width and height of the drawing area, the configure
  * callback below will do that. */ 
@@ -29,45 +72,51 @@ void _qsWin_reconfigure(struct QsWin *win)
   _qsWin_setGridX(win);
   _qsWin_setGridY(win);
 
+  // There is no render thread until there is a gc.
   if(!win->gc) return;
 
+  _qsWin_renderPause(win);
+
   win->bg = getXColor(win, win->bgR, win->bgG, win->bgB);
   
   int w, h;
   w = win->width;
   h = win->height;
 
-  if(win->pixmap)
+  if(win->fb)
   {
-    setTraceColor(win, win->bg);
+    /* The frame buffer is like the pixmap, but we send it to
+     * X11 in cb_draw() */
+    _qsWin_frameBufferFill(win, win->bg);
+    _qsWin_drawBackground(win);
+  }
+  else if(win->pixmap)
+  {
+    _qsWin_setXForeground(win, win->bg);
     XFillRectangle(win->dsp, win->pixmap, win->gc, 0, 0, w, h);
     /* we need to draw the grid and other background things
      * on the pixmap, but if there is no pixmap the grid is
      * drawn in cb_draw() */
     _qsWin_drawBackground(win);
   }
+#ifdef QS_GL
+  else if(win->gl)
+    _qsWin_drawBackground(win);
+#endif
 
-  if(win->fade)
+  // OpenGL does its own fading, so GL windows get no fade surface.
+  if(win->fade && !win->gl)
   {
     if(!win->fadeSurface)
-      win->fadeSurface = g_malloc0(sizeof(struct QsFadingColor)*w*h);
+      _qsWin_fadeInit(win);
     else
-    {
       _qsWin_traceFadeRedraws(win);
-      //memset(win->fadeSurface, 0, sizeof(struct QsFadingColor)*w*h);
-      //win->fadeFront = win->fadeRear = win->fadeLastInsert = NULL;
-    }
   }
   else if(win->fadeSurface)
-  {
     // win->fade == false
-#ifdef QS_DEBUG
-    memset(win->fadeSurface, 0, sizeof(struct QsFadingColor)*w*h);
-#endif
-    g_free(win->fadeSurface);
-    win->fadeFront = win->fadeRear = win->fadeSurface =
-      win->fadeLastInsert = NULL;
-  }
+    _qsWin_fadeCleanup(win);
+
+  _qsWin_renderResume(win);
 
   // the drawing area draw callback will fix the rest.
   gtk_widget_queue_draw_area(win->da, 0, 0, w, h);
@@ -77,7 +126,7 @@ void _qsWin_reconfigure(struct QsWin *win)
 bool _qsWin_cb_configure(GtkWidget *da, GdkEvent *e,
                         struct QsWin *win)
 {
-  int w, h;
+  int w, h, oldW, oldH;
 
   w = gtk_widget_get_allocated_width(da);
   h = gtk_widget_get_allocated_height(da);
@@ -86,6 +135,16 @@ bool _qsWin_cb_configure(GtkWidget *da, GdkEvent *e,
     // Why was this called???
     return true;
 
+  // If there is a render thread it stays paused until we are done
+  // with the new size.
+  _qsWin_renderPause(win);
+
+  if(win->fadeResample)
+    // Finish the last resize before we start this one.
+    _qsWin_fadeResample(win, true, false);
+
+  oldW = win->width;
+  oldH = win->height;
   win->width = w;
   win->height = h;
 
@@ -109,9 +168,28 @@ bool _qsWin_cb_configure(GtkWidget *da, GdkEvent *e,
     QS_ASSERT(win->cmap);
     win->gc = XCreateGC(win->dsp, win->xwin, 0, 0);
     QS_ASSERT(win->gc);
+    initColors(win);
     win->bg = getXColor(win, win->bgR, win->bgG, win->bgB);
+    XSetForeground(win->dsp, win->gc, win->bg);
+    win->xFGColor = win->bg;
+
+    if(qsApp->op_renderThread && !win->gl)
+      // If this fails we just draw in the main thread.  OpenGL
+      // draws in the main thread anyway.  It starts paused, and
+      // the _qsWin_renderResume() below starts it.
+      _qsWin_renderCreate(win);
   }
 
+  if(qsApp->op_frameBuffer && !win->gl)
+    /* If this fails, like with a 16 bit visual, we just draw
+     * with libX11 and the pixmap, if there is one. */
+    _qsWin_frameBufferCreate(win);
+
+  /* Points that are not drawn yet are for the old size.  This is
+   * after the frame buffer is made, because it does not need the
+   * point buffer. */
+  _qsWin_resizePointBins(win);
+
   if(win->pixmap)
   {
     if(win->pixmap != (intptr_t) 1)
@@ -120,7 +198,7 @@ bool _qsWin_cb_configure(GtkWidget *da, GdkEvent *e,
     win->pixmap = XCreatePixmap(win->dsp, win->xwin, w, h,
         DefaultDepth(win->dsp, DefaultScreen(win->dsp)));
 
-    setTraceColor(win, win->bg);
+    _qsWin_setXForeground(win, win->bg);
     XFillRectangle(win->dsp, win->pixmap, win->gc, 0, 0, w, h);
   }
 
@@ -133,30 +211,32 @@ bool _qsWin_cb_configure(GtkWidget *da, GdkEvent *e,
   }
 
 
-  if(win->r)
+  if(win->bgPlaneAlloc < (size_t) w*h)
   {
-    QS_ASSERT(win->g && win->b);
-    g_free(win->r);
-    g_free(win->g);
-    g_free(win->b);
+    // We keep the background plane if the window got smaller.
+    if(win->bgPlane)
+      g_free(win->bgPlane);
+    win->bgPlaneAlloc = w*h;
+    win->bgPlane = g_malloc(sizeof(*win->bgPlane)*win->bgPlaneAlloc);
   }
-
-  win->r = g_malloc0(sizeof(uint8_t)*w*h);
-  win->g = g_malloc0(sizeof(uint8_t)*w*h);
-  win->b = g_malloc0(sizeof(uint8_t)*w*h);
+  _qsWin_bgPlaneFill(win);
 
 
-  if(win->fade)
+  if(win->fade && !win->gl)
   {
-    struct QsFadingColor *fc;
     /* win->fadeSurface is a color surface/pixel array.
-     * Like a Cairo surface with RGB, and prev and next pointers
-     * so that we can traverse just the subset of it that has
-     * been drawn too. */
-    if(win->fadeSurface)
-      g_free(win->fadeSurface);
-    win->fadeSurface = fc = g_malloc0(sizeof(struct QsFadingColor)*w*h);
-    win->fadeFront = win->fadeRear = win->fadeLastInsert = NULL; 
+     * Like a Cairo surface with RGB, and a fade queue
+     * time tick so that we can traverse just the subset
+     * of it that has been drawn too. */
+    if(win->fadeSurface && oldW > 0 && oldH > 0)
+      // Keep the traces that are fading, by mapping them into
+      // the new size.
+      _qsWin_fadeResize(win, oldW, oldH);
+    else
+    {
+      _qsWin_fadeCleanup(win);
+      _qsWin_fadeInit(win);
+    }
   }
 
   /* setup gridXSpacing, gridXStart, gridYSpacing, gridYStart
@@ -166,10 +246,25 @@ bool _qsWin_cb_configure(GtkWidget *da, GdkEvent *e,
   _qsWin_setGridX(win);
   _qsWin_setGridY(win);
 
-  if(win->pixmap)
+  if(win->pixmap || win->fb || win->gl)
+  {
     /* we need to draw the grid on the pixmap, but if
      * there is no pixmap the grid is drawn in cb_draw() */
     _qsWin_drawBackground(win);
 
+    /* and the traces we kept from before the resize */
+    if(win->fadeResample)
+    {
+      // If the display is frozen there will be no fade draws
+      // to finish it, so we do it all now.
+      _qsWin_fadeResample(win, qsApp->freezeDisplay, true);
+      _qsWin_drawPoints(win);
+    }
+    else if(!win->fade)
+      _qsWin_traceSwipeRedraws(win);
+  }
+
+  _qsWin_renderResume(win);
+
   return true; /* true means the event is handled. */
 }
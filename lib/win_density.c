@@ -0,0 +1,286 @@
+/* Quickscope - a software oscilloscope
+ * Copyright (C) 2012-2014  Lance Arsenault
+ * GNU General Public License version 3
+ */
+
+// The density fade engine, QS_FADE_DENSITY.  Like a digital phosphor
+// scope we count the trace hits on each pixel, and we color the pixel
+// by its hit count with a color ramp, so a noisy signal shows where
+// the trace spends its time and not just where it was last.
+//
+// The counts are 16 bit 8.8 fixed point, so one hit adds 256.  They
+// decay with time by multiplying the lit rectangle by a 16 bit
+// fraction, with pmulhuw when we have SSE2.  We apply the decay only
+// when it adds up to DECAY_STEP, so that the counts of one or two
+// hits do not get stuck from rounding.  A single hit fades out in the
+// fade period.  There is no fade delay.
+
+#include <math.h>
+#include <string.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <X11/Xlib.h>
+#include <gtk/gtk.h>
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+#include "debug.h"
+#include "Assert.h"
+#include "base.h"
+#include "timer_priv.h"
+#include "app.h"
+#include "adjuster.h"
+#include "adjuster_priv.h"
+#include "win.h"
+#include "win_priv.h"
+
+
+#define HIT          256
+// Counts less than this are faded out.
+#define MIN_COUNT    16
+// We decay the counts when they have decayed by this much.
+#define DECAY_STEP   (15.0F/16.0F)
+
+
+static inline
+void setClean(struct QsWin *win)
+{
+  win->dnXMin = win->dnYMin = INT_MAX;
+  win->dnXMax = win->dnYMax = -1;
+}
+
+static inline
+unsigned long rampPixel(const struct QsWin *win, uint16_t count)
+{
+  return win->densityRamp[count >> QS_DENSITY_RAMP_SHIFT].pixel;
+}
+
+// c[k] = (c[k] * q) >> 16 for k in [0, n)
+static inline
+void decay(uint16_t *c, int n, uint16_t q)
+{
+  int k = 0;
+#if defined(__SSE2__)
+  {
+    const __m128i Q = _mm_set1_epi16((short) q);
+    for(; k + 8 <= n; k += 8)
+      _mm_storeu_si128((__m128i *) &c[k], _mm_mulhi_epu16(
+            _mm_loadu_si128((const __m128i *) &c[k]), Q));
+  }
+#endif
+  for(; k < n; ++k)
+    c[k] = (((uint32_t) c[k]) * q) >> 16;
+}
+
+// Make the color ramp from dark blue for the least hits, through
+// cyan, green, yellow, and red, to white for the most.  We use the
+// log of the count so that you can see both the rare and the common
+// trace paths.
+static
+void makeRamp(struct QsWin *win)
+{
+  static const float stop[][4] =
+  {
+    /* level, r, g, b */
+    { 0.00F, 0.00F, 0.15F, 0.90F },
+    { 0.30F, 0.00F, 1.00F, 1.00F },
+    { 0.50F, 0.00F, 1.00F, 0.00F },
+    { 0.70F, 1.00F, 1.00F, 0.00F },
+    { 0.90F, 1.00F, 0.00F, 0.00F },
+    { 1.00F, 1.00F, 1.00F, 1.00F }
+  };
+  const int numStops = sizeof(stop)/sizeof(stop[0]);
+  int i, s = 0;
+
+  if(!win->densityRamp)
+    win->densityRamp = g_malloc(sizeof(*win->densityRamp)*
+        QS_DENSITY_RAMP_LEN);
+
+  for(i = 0; i < QS_DENSITY_RAMP_LEN; ++i)
+  {
+    float level, f;
+    struct QsDensityColor *c;
+    level = logf(1.0F + i)/logf((float) QS_DENSITY_RAMP_LEN);
+    while(s < numStops - 2 && level > stop[s+1][0])
+      ++s;
+    f = (level - stop[s][0])/(stop[s+1][0] - stop[s][0]);
+    if(f > 1.0F) f = 1.0F;
+
+    c = win->densityRamp + i;
+    c->r = (stop[s][1] + f*(stop[s+1][1] - stop[s][1])) * RMAX + 0.5F;
+    c->g = (stop[s][2] + f*(stop[s+1][2] - stop[s][2])) * GMAX + 0.5F;
+    c->b = (stop[s][3] + f*(stop[s+1][3] - stop[s][3])) * BMAX + 0.5F;
+    c->pixel = getXColor(win, c->r, c->g, c->b);
+  }
+}
+
+// The fade surface must be made already.
+void _qsWin_densityInit(struct QsWin *win)
+{
+  QS_ASSERT(win && win->fadeSurface);
+  QS_ASSERT(!win->density);
+  QS_ASSERT(win->width > 0 && win->height > 0);
+
+  win->density = g_malloc0(sizeof(*win->density)*
+      win->width*win->height);
+  setClean(win);
+  win->densityDecay = 1.0F;
+  makeRamp(win);
+  win->fadeLastTime = _qsTimer_get(qsApp->timer);
+}
+
+void _qsWin_densityCleanup(struct QsWin *win)
+{
+  QS_ASSERT(win);
+
+  if(win->density)
+    g_free(win->density);
+  if(win->densityRamp)
+    g_free(win->densityRamp);
+  win->density = NULL;
+  win->densityRamp = NULL;
+  setClean(win);
+}
+
+// All points must be in the view port.
+void _qsWin_densityDrawTracePoints(struct QsWin *win, const XPoint *p,
+    int n)
+{
+  QS_ASSERT(win && win->density && win->fadeSurface);
+  QS_ASSERT(n > 0);
+
+  struct QsFadePixel *FP;
+  uint16_t *C;
+  int k, w;
+
+  FP = win->fadeSurface;
+  C = win->density;
+  w = win->width;
+
+  if(win->dnXMax < win->dnXMin)
+  {
+    // Nothing is lit, so fadeLastTime may be old and the decay left
+    // over from before the idle time.  Start fresh, so that these
+    // new counts don't get decayed by all that idle time.
+    win->fadeLastTime = _qsTimer_get(qsApp->timer);
+    win->densityDecay = 1.0F;
+  }
+
+  for(k = 0; k < n; ++k)
+  {
+    int x, y;
+    uint32_t i;
+    x = p[k].x;
+    y = p[k].y;
+    QS_ASSERT(x >= 0 && x < w && y >= 0 && y < win->height);
+    i = w*y + x;
+
+    if(!FP[i].tick)
+      // It was swiped or never lit.
+      C[i] = 0;
+    C[i] = (C[i] < 0xFFFF - HIT)?(C[i] + HIT):0xFFFF;
+    FP[i].tick = 1;
+
+    if(x < win->dnXMin) win->dnXMin = x;
+    if(x > win->dnXMax) win->dnXMax = x;
+    if(y < win->dnYMin) win->dnYMin = y;
+    if(y > win->dnYMax) win->dnYMax = y;
+
+    setTraceColor(win, rampPixel(win, C[i]));
+    xDrawPoint(win, x, y);
+  }
+}
+
+// Decay the counts from the last fade draw time to time t, if it's
+// time to, and redraw the lit pixels.
+void _qsWin_densityDraw(struct QsWin *win, long double t)
+{
+  QS_ASSERT(win && win->density && win->fadeSurface);
+
+  struct QsFadePixel *FP;
+  uint16_t q;
+  float alpha;
+  int x, y, w, xMin, yMin, xMax, yMax;
+
+  // One hit decays to MIN_COUNT in the fade period.
+  if(win->fadePeriod > 0.000001F)
+    alpha = logf(((float) MIN_COUNT)/HIT)/win->fadePeriod;
+  else
+    alpha = -1.0e+7F;
+  win->densityDecay *= expf(alpha * (float) (t - win->fadeLastTime));
+  win->fadeLastTime = t;
+
+  if(win->densityDecay > DECAY_STEP || win->dnXMax < win->dnXMin)
+    return;
+
+  q = win->densityDecay * 0xFFFF;
+  win->densityDecay = 1.0F;
+
+  FP = win->fadeSurface;
+  w = win->width;
+  xMin = win->dnXMin;
+  xMax = win->dnXMax;
+  yMin = win->dnYMin;
+  yMax = win->dnYMax;
+  setClean(win);
+
+  for(y = yMin; y <= yMax; ++y)
+  {
+    uint16_t *C;
+    struct QsFadePixel *fp;
+    C = win->density + w*y;
+    fp = FP + w*y;
+
+    decay(C + xMin, xMax - xMin + 1, q);
+
+    for(x = xMin; x <= xMax; ++x)
+    {
+      if(!fp[x].tick)
+      {
+        // It got swiped, or is not lit.
+        C[x] = 0;
+        continue;
+      }
+
+      if(C[x] < MIN_COUNT)
+      {
+        uint32_t i;
+        i = w*y + x;
+        C[x] = 0;
+        fp[x].tick = 0;
+        setTraceColor(win, bgPlaneColor(win, i));
+        xDrawPoint(win, x, y);
+        continue;
+      }
+
+      if(x < win->dnXMin) win->dnXMin = x;
+      if(x > win->dnXMax) win->dnXMax = x;
+      if(y < win->dnYMin) win->dnYMin = y;
+      if(y > win->dnYMax) win->dnYMax = y;
+
+      setTraceColor(win, rampPixel(win, C[x]));
+      xDrawPoint(win, x, y);
+    }
+  }
+}
+
+// Draw the lit pixels without any decay.
+void _qsWin_densityRedraw(struct QsWin *win)
+{
+  QS_ASSERT(win && win->density && win->fadeSurface);
+
+  int x, y, w;
+  w = win->width;
+
+  for(y = win->dnYMin; y <= win->dnYMax; ++y)
+    for(x = win->dnXMin; x <= win->dnXMax; ++x)
+    {
+      uint32_t i;
+      i = w*y + x;
+      if(!win->fadeSurface[i].tick)
+        continue;
+      setTraceColor(win, rampPixel(win, win->density[i]));
+      xDrawPoint(win, x, y);
+    }
+}
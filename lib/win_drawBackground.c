@@ -9,6 +9,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <X11/Xlib.h>
+#include <X11/Xutil.h>
 #include <gtk/gtk.h>
 #include <gdk/gdkx.h>
 #include <gdk/gdkkeysyms.h>
@@ -22,11 +23,42 @@
 #include "win_priv.h"
 
 
+/* Everything that the background is drawn from.  We memcmp() these
+ * so it's memset() to zero before setting it. */
+struct QsBackgroundKey
+{
+  int width, height;
+  uint8_t colors[15];
+  uint8_t gridXLineUnits, gridYLineUnits;
+  bool grid, ticks, subGrid, axis;
+  float gridXSpacing, gridXStart, gridYSpacing, gridYStart,
+        gridXWinOffset, gridYWinOffset,
+        gridLineWidth, tickLineWidth, tickLineLength,
+        subGridLineWidth, axisLineWidth,
+        xScale, yScale;
+  int xShift, yShift;
+};
+
+struct QsBackgroundCache
+{
+  struct QsBackgroundKey key;
+  struct QsBgPixel *plane; /* copy of win->bgPlane */
+  XImage *image; /* the X11 pixels of the background */
+};
+
+
 // Speed is not too much of an issue in the drawing in this file.
 // This drawing is only done when there is an event that causes
 // a redraw, like a window uncovering, or window resize.
 // We expect that this code draws a lot faster than Cairo.
 // Speed may become an issue if we use Cairo to draw in here.
+//
+// We draw the background into the win->bgPlane restore colors
+// only, and keep a copy of them with an X11 image of them in
+// the background cache.  If nothing that the background is drawn
+// from changed, like when a trace adjuster calls
+// _qsWin_reconfigure(), we just copy the restore colors from the
+// cache and send the image to X11 with one XPutImage().
 
 
 static inline
@@ -39,37 +71,24 @@ void DrawPoint(struct QsWin *win,
   QS_ASSERT(frac >= 0);
   QS_ASSERT(frac <= 1);
   
-  // not thread safe.
-  static float lastR = -100, lastG = -100, lastB = -100;
-  int i;
-  i = w*y + x;
+  struct QsBgPixel *bp;
+  bp = win->bgPlane + w*y + x;
 
 
   if(frac == 1)
   {
-    win->r[i] = r;
-    win->g[i] = g;
-    win->b[i] = b;
+    bp->r = r;
+    bp->g = g;
+    bp->b = b;
   }
   else
   {
     // We have a fraction of the color on top of
     // what is there now.
-    r = win->r[i] += (r - win->r[i]) * frac + 0.5F;
-    g = win->g[i] += (g - win->g[i]) * frac + 0.5F;
-    b = win->b[i] += (b - win->b[i]) * frac + 0.5F;
+    bp->r += (r - bp->r) * frac + 0.5F;
+    bp->g += (g - bp->g) * frac + 0.5F;
+    bp->b += (b - bp->b) * frac + 0.5F;
   }
-
-  if(r != lastR || g != lastG || b != lastB)
-  {
-    // Don't change the color unless we must.
-    // With all this line drawing the color
-    // will not change all the time.
-    lastR = r; lastG = g; lastB = b;
-    setTraceColor(win, getXColor(win, r, g, b));
-  }
-
-  xDrawPoint(win, x, y);
 }
 
 /*
@@ -381,7 +400,6 @@ void DrawTickRec(struct QsWin *win,
   }
 
   /* Fill in the inner rectangle with tick color */
-  setTraceColor(win, getXColor(win, tickR, tickG, tickB));
   for(ix = ixmin + 1; ix < ixmax; ++ix)
   {
     for(iy = iymin + 1; iy < iymax; ++iy)
@@ -400,7 +418,8 @@ void DrawTickRec(struct QsWin *win,
  * drawing does some crude anti-aliasing so that the grid lines
  * can be put at any floating point pixels positions with any
  * floating point pixel width greater than or equal to one. */
-void _qsWin_drawBackground(struct QsWin *win)
+static
+void drawGridStuff(struct QsWin *win)
 {
   int w, h;
   
@@ -410,23 +429,6 @@ void _qsWin_drawBackground(struct QsWin *win)
   h = win->height;
 
 
-  { // We must (re)initialize the drawing area background pixels.
-    int i, n;
-    n = w*h;
-    for(i=0; i<n; ++i)
-    {
-      // blank background
-      win->r[i] =  win->bgR;
-      win->g[i] =  win->bgG;
-      win->b[i] =  win->bgB;
-    }
-  }
-
-  if(!_qsWin_isGridStuff(win))
-    // Nothing but the blank background
-    return;
-
-
   bool noGrid;
   noGrid = (win->grid)?false:true;
   
@@ -1023,7 +1025,200 @@ void _qsWin_drawBackground(struct QsWin *win)
           win->axisLineWidth, w, h,
           win->gridYWinOffset * win->yScale + win->yShift);
   }
+}
+
+static
+void makeKey(const struct QsWin *win, struct QsBackgroundKey *k)
+{
+  memset(k, 0, sizeof(*k));
+  k->width = win->width;
+  k->height = win->height;
+  k->colors[0] = win->bgR;
+  k->colors[1] = win->bgG;
+  k->colors[2] = win->bgB;
+  k->colors[3] = win->gridR;
+  k->colors[4] = win->gridG;
+  k->colors[5] = win->gridB;
+  k->colors[6] = win->axisR;
+  k->colors[7] = win->axisG;
+  k->colors[8] = win->axisB;
+  k->colors[9] = win->subGridR;
+  k->colors[10] = win->subGridG;
+  k->colors[11] = win->subGridB;
+  k->colors[12] = win->tickR;
+  k->colors[13] = win->tickG;
+  k->colors[14] = win->tickB;
+  k->gridXLineUnits = win->gridXLineUnits;
+  k->gridYLineUnits = win->gridYLineUnits;
+  k->grid = win->grid;
+  k->ticks = win->ticks;
+  k->subGrid = win->subGrid;
+  k->axis = win->axis;
+  k->gridXSpacing = win->gridXSpacing;
+  k->gridXStart = win->gridXStart;
+  k->gridYSpacing = win->gridYSpacing;
+  k->gridYStart = win->gridYStart;
+  k->gridXWinOffset = win->gridXWinOffset;
+  k->gridYWinOffset = win->gridYWinOffset;
+  k->gridLineWidth = win->gridLineWidth;
+  k->tickLineWidth = win->tickLineWidth;
+  k->tickLineLength = win->tickLineLength;
+  k->subGridLineWidth = win->subGridLineWidth;
+  k->axisLineWidth = win->axisLineWidth;
+  k->xScale = win->xScale;
+  k->yScale = win->yScale;
+  k->xShift = win->xShift;
+  k->yShift = win->yShift;
+}
+
+static
+void freeCacheImage(struct QsBackgroundCache *c)
+{
+  if(!c->image) return;
+  g_free(c->image->data);
+  // So XDestroyImage() does not free() the data.
+  c->image->data = NULL;
+  XDestroyImage(c->image);
+  c->image = NULL;
+}
+
+// Save the background that is in win->bgPlane in the cache.
+static
+void cacheStore(struct QsWin *win, const struct QsBackgroundKey *key)
+{
+  struct QsBackgroundCache *c;
+  int w, h, x, y, n;
+
+  w = win->width;
+  h = win->height;
+  n = w*h;
+
+  if(!win->bgCache)
+    win->bgCache = g_malloc0(sizeof(*win->bgCache));
+  c = win->bgCache;
+
+  if(c->key.width != w || c->key.height != h || !c->plane)
+  {
+    freeCacheImage(c);
+    c->plane = g_realloc(c->plane, sizeof(*c->plane)*n);
+  }
+
+  if(!c->image)
+  {
+    c->image = XCreateImage(win->dsp,
+        DefaultVisual(win->dsp, DefaultScreen(win->dsp)),
+        DefaultDepth(win->dsp, DefaultScreen(win->dsp)),
+        ZPixmap, 0, NULL, w, h, 32, 0);
+    QS_ASSERT(c->image);
+    c->image->data = g_malloc(c->image->bytes_per_line * h);
+  }
+
+  memcpy(c->plane, win->bgPlane, sizeof(*c->plane)*n);
+  c->key = *key;
+
+  for(y = 0; y < h; ++y)
+  {
+    int i;
+    i = w*y;
+    if(c->image->bits_per_pixel == 32)
+    {
+      uint32_t *row;
+      row = (uint32_t *) (c->image->data + y * c->image->bytes_per_line);
+      for(x = 0; x < w; ++x, ++i)
+        row[x] = bgPlaneColor(win, i);
+    }
+    else
+      for(x = 0; x < w; ++x, ++i)
+        XPutPixel(c->image, x, y, bgPlaneColor(win, i));
+  }
+}
+
+// Send the cached background image to X11, or the frame buffer.
+static
+void cacheDraw(struct QsWin *win)
+{
+  struct QsBackgroundCache *c;
+  c = win->bgCache;
+  QS_ASSERT(c && c->image);
+
+  if(win->fb && c->image->bits_per_pixel == 32)
+  {
+    int y;
+    for(y = 0; y < win->height; ++y)
+      memcpy(win->fb + y * win->fbStride,
+          c->image->data + y * c->image->bytes_per_line,
+          4 * win->width);
+    _qsWin_frameBufferSetDirty(win);
+    return;
+  }
+
+  QS_ASSERT(!win->fb);
+  XPutImage(win->dsp, (win->pixmap)?win->pixmap:win->xwin, win->gc,
+      c->image, 0, 0, 0, 0, win->width, win->height);
+}
 
+void _qsWin_drawBackground(struct QsWin *win)
+{
+  QS_ASSERT(win);
+  QS_ASSERT(win->bgPlane);
+
+  int n;
+  struct QsBackgroundKey key;
+
+  n = win->width * win->height;
+
+  // Points not drawn yet are on top of the background.
   _qsWin_drawPoints(win);
+
+  if(!_qsWin_isGridStuff(win))
+  {
+    // Nothing but the blank background, which the caller drew.
+    _qsWin_bgPlaneFill(win);
+#ifdef QS_GL
+    if(win->gl)
+      _qsWin_glBackgroundChanged(win);
+#endif
+    return;
+  }
+
+  makeKey(win, &key);
+
+  if(win->bgCache && win->bgCache->image &&
+      !memcmp(&key, &win->bgCache->key, sizeof(key)))
+  {
+    memcpy(win->bgPlane, win->bgCache->plane, sizeof(*win->bgPlane)*n);
+  }
+  else
+  {
+    // We must (re)initialize the drawing area background pixels.
+    _qsWin_bgPlaneFill(win);
+    drawGridStuff(win);
+    cacheStore(win, &key);
+  }
+
+#ifdef QS_GL
+  if(win->gl)
+  {
+    // The GL back end draws from win->bgPlane.
+    _qsWin_glBackgroundChanged(win);
+    return;
+  }
+#endif
+
+  cacheDraw(win);
+}
+
+void _qsWin_backgroundCacheCleanup(struct QsWin *win)
+{
+  QS_ASSERT(win);
+  struct QsBackgroundCache *c;
+  c = win->bgCache;
+  if(!c) return;
+
+  freeCacheImage(c);
+  if(c->plane)
+    g_free(c->plane);
+  g_free(c);
+  win->bgCache = NULL;
 }
 
@@ -3,6 +3,7 @@
  * GNU General Public License version 3
  */
 #include <math.h>
+#include <string.h>
 #include <limits.h>
 #include <inttypes.h>
 #include <stdbool.h>
@@ -20,91 +21,544 @@
 #include "win_fadeDraw_priv.h"
 
 
-#if 0
-//#ifdef QS_DEBUG
+// We quantize the fade time t0 into ticks, so that every pixel drawn
+// in the same tick fades the same.  There are 64 ticks in a fade
+// period, which is more intensity steps than you can see, but we do
+// not make ticks shorter than we will ever fade draw, and we keep the
+// number of buckets from getting silly with large fade delays.
+#define TICKS_PER_PERIOD   64
+#define MIN_TICK           (1.0L/120.0L)
+#define MAX_BUCKETS        4096
+// With fade worker threads we do not cut the drawing area into tiles
+// with less rows than this.
+#define MIN_TILE_ROWS      16
+// The number of old fade surface pixels that we resample per fade
+// draw after a window resize.
+#define RESAMPLE_PIXELS    (1 << 18)
 
-// CHECK_LIST is a very very expensive debugging tool,
-// so we tend to leave it off, even with QS_DEBUG.
-//
-#  define CHECK_LIST(win) _check_list(win)
 
-void _check_list(struct QsWin *win)
+static inline
+uint32_t fadeTick(const struct QsFadeQueue *q, long double t0)
 {
-  QS_ASSERT(win && win->fade && win->fadeSurface);
+  long double x;
+  x = (t0 - q->tBase)/q->dt;
+  if(x < 0.0L)
+    return 1;
+  // tick 0 is for pixels that are not queued
+  return ((uint32_t) x) + 1;
+}
 
-  QS_VASSERT((win->fadeFront && win->fadeRear) ||
-      (!win->fadeFront && !win->fadeRear), "front=%p rear=%p",
-      win->fadeFront, win->fadeRear);
+static inline
+float fadeAlpha(const struct QsWin *win)
+{
+#ifdef LINEAR_FADE
+  return win->fadePeriod;
+#else
+  return win->fadeAlpha;
+#endif
+}
 
-  struct QsFadingColor *fc, *last = NULL;
-  int count = 0;
-  
-  for(fc = win->fadeFront; fc; fc = fc->prev)
+static inline
+void tileSetClean(struct QsFadeQueue *q)
+{
+  q->xMin = q->yMin = INT_MAX;
+  q->xMax = q->yMax = -1;
+}
+
+// Draw X11 pixel color at x, y.  If direct is set we are in a fade
+// worker thread, so we write the frame buffer and the tile's dirty
+// rectangle, and we do not touch the drawing state in win that the
+// other threads share.
+static inline
+void drawPixel(struct QsWin *win, struct QsFadeQueue *q,
+    int x, int y, unsigned long pixel, bool direct)
+{
+  if(direct)
   {
-    if(fc->next)
-    {
-      QS_VASSERT(fc->next->prev == fc, "element %d from front", count);
-      QS_ASSERT(fc->next->t0 <= fc->t0);
-    }
-    if(fc->prev)
+    win->fb[y * win->fbStride + x] = pixel;
+    if(x < q->xMin) q->xMin = x;
+    if(x > q->xMax) q->xMax = x;
+    if(y < q->yMin) q->yMin = y;
+    if(y > q->yMax) q->yMax = y;
+    return;
+  }
+  setTraceColor(win, pixel);
+  xDrawPoint(win, x, y);
+}
+
+static inline
+void drawBackgroundPixel(struct QsWin *win, struct QsFadeQueue *q,
+    uint32_t i, bool direct)
+{
+  int x, y;
+  y = i/win->width;
+  x = i - y*win->width;
+  drawPixel(win, q, x, y,
+      bgPlaneColor(win, i), direct);
+}
+
+// Draw all the pixels in the bucket as background, and empty it.
+static
+void expireBucket(struct QsWin *win, struct QsFadeQueue *q,
+    struct QsFadeBucket *bk, bool direct)
+{
+  struct QsFadePixel *FP;
+  uint32_t k;
+  FP = win->fadeSurface;
+
+  for(k = 0; k < bk->len; ++k)
+  {
+    uint32_t i;
+    i = bk->index[k];
+    if(FP[i].tick == bk->tick)
     {
-      QS_VASSERT(fc->prev->next == fc, "element %d from front", count);
-      QS_ASSERT(fc->prev->t0 >= fc->t0);
+      FP[i].tick = 0;
+      drawBackgroundPixel(win, q, i, direct);
     }
+  }
+  QS_ASSERT(q->count >= bk->len);
+  q->count -= bk->len;
+  bk->len = 0;
+}
+
+// Put pixel index i in the bucket for tick.
+static inline
+void fadePush(struct QsWin *win, uint32_t i, uint32_t tick)
+{
+  struct QsFadeQueue *q;
+  struct QsFadeBucket *bk;
+  q = _qsWin_fadeQueueOf(win, i);
+
+  QS_ASSERT(tick);
+
+  if(win->fadeSurface[i].tick == tick)
+    // It's in this bucket already.
+    return;
 
-    last = fc;
+  bk = q->bucket + (tick % q->numBuckets);
 
-    ++count;
+  if(bk->tick != tick)
+  {
+    if(bk->len)
+      // This bucket has an older tick that _qsWin_fadeDraw() did
+      // not get to, so its pixels are all faded out by now.
+      expireBucket(win, q, bk, false);
+    bk->tick = tick;
   }
 
-  QS_ASSERT(last == win->fadeRear);
-  count = 0;
+  if(!q->count || tick < q->front)
+    q->front = tick;
+
+  if(bk->len == bk->alloc)
+  {
+    bk->alloc = (bk->alloc)?(bk->alloc * 2):64;
+    bk->index = g_realloc(bk->index, sizeof(*bk->index)*bk->alloc);
+  }
+  bk->index[bk->len++] = i;
+  ++q->count;
+  win->fadeSurface[i].tick = tick;
+}
 
-  for(fc = win->fadeRear; fc; fc = fc->next)
+// Set the tick length and number of buckets from the fade
+// parameters.  The buckets must be empty.  All the tiles get the
+// same ticks, so a tick from one fade queue is good in all of them.
+static
+void fadeSetTicks(struct QsWin *win, struct QsFadeQueue *q, long double t)
+{
+  long double span;
+  uint32_t n;
+
+  QS_ASSERT(!q->count);
+
+  span = (long double) win->fadePeriod + win->fadeDelay;
+  q->dt = win->fadePeriod/TICKS_PER_PERIOD;
+  if(q->dt < MIN_TICK)
+    q->dt = MIN_TICK;
+  if(q->dt < span/MAX_BUCKETS)
+    q->dt = span/MAX_BUCKETS;
+  // So that the ticks of the pixels that are not faded out yet
+  // are at or after tick 1.
+  q->tBase = t - span - q->dt;
+
+  // A pixel is in the buckets from tick(t + delay) until it fades
+  // out at tick(t - period), so we need a little more than that many
+  // buckets so that no two living ticks share a bucket.
+  n = span/q->dt + 3;
+
+  if(q->numBuckets != n)
   {
-    if(fc->next)
-      QS_VASSERT(fc->next->prev == fc, "element %d from rear", count);
-    if(fc->prev)
-      QS_VASSERT(fc->prev->next == fc, "element %d from rear", count);
+    uint32_t k;
+    for(k = 0; k < q->numBuckets; ++k)
+      if(q->bucket[k].index)
+        g_free(q->bucket[k].index);
+    if(q->bucket)
+      g_free(q->bucket);
+    q->bucket = g_malloc0(sizeof(*q->bucket)*n);
+    q->numBuckets = n;
+  }
+  q->front = 0;
+}
 
-    last = fc;
+static
+void freeResample(struct QsWin *win)
+{
+  struct QsFadeResample *r;
+  r = win->fadeResample;
+  if(!r) return;
+  g_free(r->surface);
+  if(r->phosphor)
+    g_free(r->phosphor);
+  if(r->density)
+    g_free(r->density);
+  g_free(r);
+  win->fadeResample = NULL;
+}
 
-    ++count;
+// Makes the fade surface and fade queues for the current window
+// width and height.
+void _qsWin_fadeInit(struct QsWin *win)
+{
+  QS_ASSERT(win);
+  QS_ASSERT(!win->fadeSurface && !win->fadeQueue);
+  QS_ASSERT(win->width > 0 && win->height > 0);
+
+  int threads, rows, k;
+  long double t;
+
+  win->fadeSurface = g_malloc0(sizeof(*win->fadeSurface)*
+      win->width*win->height);
+
+  if(win->fadeEngine == QS_FADE_PHOSPHOR)
+  {
+    _qsWin_phosphorInit(win);
+    return;
+  }
+  if(win->fadeEngine == QS_FADE_DENSITY)
+  {
+    _qsWin_densityInit(win);
+    return;
   }
 
-  QS_ASSERT(last == win->fadeFront);
+  // The worker threads can only draw into the frame buffer.  The
+  // libX11 point drawing is not thread safe.
+  threads = qsApp->op_fadeThreads;
+  if(threads > 1 && win->fb)
+  {
+    // We make two tiles per thread, so that a thread that gets
+    // tiles with less fading pixels in them can take more tiles.
+    rows = (win->height + 2*threads - 1)/(2*threads);
+    if(rows < MIN_TILE_ROWS)
+      rows = MIN_TILE_ROWS;
+  }
+  else
+    rows = win->height;
+
+  win->numFadeTiles = (win->height + rows - 1)/rows;
+  win->fadeTilePixels = win->width*rows;
+  win->fadeQueue = g_malloc0(sizeof(*win->fadeQueue)*win->numFadeTiles);
+
+  t = _qsTimer_get(qsApp->timer);
+  for(k = 0; k < win->numFadeTiles; ++k)
+  {
+    fadeSetTicks(win, win->fadeQueue + k, t);
+    tileSetClean(win->fadeQueue + k);
+  }
 
+  if(win->numFadeTiles > 1)
+  {
+    // This thread does fade drawing too, so we need one less.
+    win->fadeThreads = _qsWin_fadeThreadsCreate(win, threads - 1);
+    QS_SPEW("fade drawing %d tiles with %d threads\n",
+        win->numFadeTiles, threads);
+  }
 }
 
-#else
+void _qsWin_fadeCleanup(struct QsWin *win)
+{
+  QS_ASSERT(win);
+  int n;
 
-#  define CHECK_LIST(win)  /*empty macro*/
+  freeResample(win);
+  _qsWin_phosphorCleanup(win);
+  _qsWin_densityCleanup(win);
 
-#endif
+  if(win->fadeThreads)
+    _qsWin_fadeThreadsDestroy(win->fadeThreads);
+  win->fadeThreads = NULL;
 
+  for(n = 0; n < win->numFadeTiles; ++n)
+  {
+    struct QsFadeQueue *q;
+    uint32_t k;
+    q = win->fadeQueue + n;
+    for(k = 0; k < q->numBuckets; ++k)
+      if(q->bucket[k].index)
+        g_free(q->bucket[k].index);
+    if(q->bucket)
+      g_free(q->bucket);
+  }
+  if(win->fadeQueue)
+    g_free(win->fadeQueue);
+  win->fadeQueue = NULL;
+  win->numFadeTiles = 0;
+  win->fadeTilePixels = 0;
+
+  if(win->fadeSurface)
+    g_free(win->fadeSurface);
+  win->fadeSurface = NULL;
+}
+
+// The fade period or delay changed, so we change the tick length
+// and move the queued pixels into the new buckets, keeping their
+// times.
+void _qsWin_fadeRebucket(struct QsWin *win)
+{
+  QS_ASSERT(win);
+
+  if(win->phosphor)
+    _qsWin_phosphorSetParams(win);
+
+  if(!win->fadeQueue) return;
+
+  struct QsFadePixel *FP;
+  uint32_t *index, k;
+  long double *t0, t;
+  size_t n = 0, j, count = 0;
+  float alpha;
+  int tile;
+
+  FP = win->fadeSurface;
+  t = _qsTimer_get(qsApp->timer);
+  alpha = fadeAlpha(win);
+
+  for(tile = 0; tile < win->numFadeTiles; ++tile)
+    count += win->fadeQueue[tile].count;
+
+  index = g_malloc(sizeof(*index)*(count + 1));
+  t0 = g_malloc(sizeof(*t0)*(count + 1));
+
+  for(tile = 0; tile < win->numFadeTiles; ++tile)
+  {
+    struct QsFadeQueue *q;
+    q = win->fadeQueue + tile;
+
+    // Pull all the live pixels out of the buckets.  Zeroing the
+    // pixel tick drops any repeated index.
+    for(k = 0; k < q->numBuckets; ++k)
+    {
+      struct QsFadeBucket *bk;
+      uint32_t m;
+      long double tt;
+      bk = q->bucket + k;
+      tt = _qsFadeQueue_tickTime(q, bk->tick);
+      for(m = 0; m < bk->len; ++m)
+        if(FP[bk->index[m]].tick == bk->tick)
+        {
+          FP[bk->index[m]].tick = 0;
+          if(_qsWin_fadeIntensity(alpha, tt, t) < MIN_INTENSITY)
+            drawBackgroundPixel(win, q, bk->index[m], false);
+          else
+          {
+            index[n] = bk->index[m];
+            t0[n++] = tt;
+          }
+        }
+      bk->len = 0;
+    }
+    q->count = 0;
+
+    fadeSetTicks(win, q, t);
+  }
+
+  for(j = 0; j < n; ++j)
+    fadePush(win, index[j], fadeTick(win->fadeQueue, t0[j]));
+
+  g_free(index);
+  g_free(t0);
+
+  _qsWin_drawPoints(win);
+}
+
+// The window changed size from oldWidth x oldHeight.  We make a new
+// fade surface and keep the old one so that _qsWin_fadeResample() can
+// map the lit pixels into the new one, with their times or
+// intensities, so that the traces do not blank out at every resize.
+void _qsWin_fadeResize(struct QsWin *win, int oldWidth, int oldHeight)
+{
+  QS_ASSERT(win && win->fadeSurface);
+  QS_ASSERT(!win->fadeResample);
+  QS_ASSERT(oldWidth > 0 && oldHeight > 0);
+
+  struct QsFadeResample *r;
+
+  r = g_malloc0(sizeof(*r));
+  r->surface = win->fadeSurface;
+  r->phosphor = win->phosphor;
+  r->density = win->density;
+  r->width = oldWidth;
+  r->height = oldHeight;
+  if(win->fadeQueue)
+  {
+    // All the tiles have the same ticks.
+    r->tBase = win->fadeQueue->tBase;
+    r->dt = win->fadeQueue->dt;
+  }
+
+  // So that _qsWin_fadeCleanup() does not free them.
+  win->fadeSurface = NULL;
+  win->phosphor = NULL;
+  win->density = NULL;
+
+  _qsWin_fadeCleanup(win);
+  _qsWin_fadeInit(win);
+
+  win->fadeResample = r;
+}
+
+// Put old pixel oi into new pixel i, if it's newer or brighter than
+// what is there.  Returns true with the X11 pixel color to draw it
+// with, or false if it was not put there.
 static inline
-void removeFC(struct QsWin *win, struct QsFadingColor *fc)
+bool resamplePixel(struct QsWin *win, const struct QsFadeResample *r,
+    uint32_t oi, uint32_t i, int x, int y,
+    uint32_t tick, float I, unsigned long *pixel)
+{
+  struct QsFadePixel *fp;
+  const struct QsFadePixel *op;
+  fp = win->fadeSurface + i;
+  op = r->surface + oi;
+
+  if(win->phosphor)
+  {
+    if(fp->tick && win->phosphor[i] >= I)
+      return false;
+    win->phosphor[i] = I;
+    fp->tick = 1;
+    if(x < win->phXMin) win->phXMin = x;
+    if(x > win->phXMax) win->phXMax = x;
+    if(y < win->phYMin) win->phYMin = y;
+    if(y > win->phYMax) win->phYMax = y;
+  }
+  else if(win->density)
+  {
+    uint16_t c;
+    c = r->density[oi];
+    if(fp->tick && win->density[i] >= c)
+      return false;
+    win->density[i] = c;
+    fp->tick = 1;
+    if(x < win->dnXMin) win->dnXMin = x;
+    if(x > win->dnXMax) win->dnXMax = x;
+    if(y < win->dnYMin) win->dnYMin = y;
+    if(y > win->dnYMax) win->dnYMax = y;
+    *pixel = win->densityRamp[c >> QS_DENSITY_RAMP_SHIFT].pixel;
+    return true;
+  }
+  else
+  {
+    if(fp->tick >= tick)
+      // A pixel from the same or a later tick is there.
+      return false;
+    fadePush(win, i, tick);
+  }
+
+  fp->r = op->r;
+  fp->g = op->g;
+  fp->b = op->b;
+
+  if(I >= 1.0F)
+    *pixel = getXColor(win, fp->r, fp->g, fp->b);
+  else
+    *pixel = fadeColor(win, fp, win->width, x, y, I);
+  return true;
+}
+
+// Map the rows of the fade surface from before the last resize into
+// the current fade surface.  We do a limited number of rows per call,
+// unless all is set, so that resizing a large window does not stall
+// the drawing.  If draw is set we draw the pixels that we add.
+void _qsWin_fadeResample(struct QsWin *win, bool all, bool draw)
 {
-  if(fc->next)
-    fc->next->prev = fc->prev;
-  else if(fc == win->fadeFront)
+  QS_ASSERT(win);
+
+  struct QsFadeResample *r;
+  struct QsFadeQueue oldQ;
+  float alpha;
+  int w, h, rowEnd;
+
+  r = win->fadeResample;
+  if(!r) return;
+
+  QS_ASSERT(win->fadeSurface);
+  QS_ASSERT(!r->phosphor == !win->phosphor);
+  QS_ASSERT(!r->density == !win->density);
+
+  w = win->width;
+  h = win->height;
+  alpha = fadeAlpha(win);
+  memset(&oldQ, 0, sizeof(oldQ));
+  oldQ.tBase = r->tBase;
+  oldQ.dt = r->dt;
+
+  if(all)
+    rowEnd = r->height;
+  else
   {
-    win->fadeFront = fc->prev;
-    if(fc->prev)
-      fc->prev->next = NULL;
+    rowEnd = r->row + RESAMPLE_PIXELS/r->width;
+    if(rowEnd == r->row)
+      ++rowEnd;
+    if(rowEnd > r->height)
+      rowEnd = r->height;
   }
 
-  if(fc->prev)
-    fc->prev->next = fc->next;
-  else if(fc == win->fadeRear)
+  for(; r->row < rowEnd; ++r->row)
   {
-    win->fadeRear = fc->next;
-    if(fc->next)
-      fc->next->prev = NULL;
+    int ox, y0, y1;
+    _qsWin_resampleSpan(r->row, r->height, h, &y0, &y1);
+
+    for(ox = 0; ox < r->width; ++ox)
+    {
+      uint32_t oi, tick = 0;
+      float I;
+      int x0, x1, x, y;
+
+      oi = r->width * r->row + ox;
+      if(!r->surface[oi].tick)
+        continue;
+
+      if(r->phosphor)
+        I = r->phosphor[oi];
+      else if(r->density)
+        I = 1.0F;
+      else
+      {
+        long double t0;
+        t0 = _qsFadeQueue_tickTime(&oldQ, r->surface[oi].tick);
+        I = _qsWin_fadeIntensity(alpha, t0, win->fadeLastTime);
+        tick = fadeTick(win->fadeQueue, t0);
+      }
+      if(I < MIN_INTENSITY || (r->density && !r->density[oi]))
+        // It's faded out.
+        continue;
+
+      _qsWin_resampleSpan(ox, r->width, w, &x0, &x1);
+
+      for(y = y0; y < y1; ++y)
+        for(x = x0; x < x1; ++x)
+        {
+          unsigned long pixel;
+          if(resamplePixel(win, r, oi, w*y + x, x, y, tick, I,
+                &pixel) && draw)
+          {
+            setTraceColor(win, pixel);
+            xDrawPoint(win, x, y);
+          }
+        }
+    }
   }
 
-  if(fc == win->fadeLastInsert)
-    win->fadeLastInsert = NULL;
+  if(r->row == r->height)
+    freeResample(win);
 }
 
 // x, y must satisfy (x >= 0 && x < w && y >= 0 && y < h)
@@ -117,6 +571,18 @@ void _qsWin_drawTracePoint(struct QsWin *win, int x, int y,
   QS_ASSERT(b >= 0.0F && b <= 1.0F);
   QS_ASSERT(x >= 0.0F && x < win->width && y >= 0 && y < win->height);
 
+#ifdef QS_GL
+  if(win->gl)
+  {
+    // OpenGL does the fading.
+    XPoint p;
+    p.x = x;
+    p.y = y;
+    _qsWin_glAddPoints(win, &p, 1, r, g, b, t);
+    return;
+  }
+#endif
+
   if(!win->fade)
   {
     QS_ASSERT(!win->fadeSurface);
@@ -127,117 +593,226 @@ void _qsWin_drawTracePoint(struct QsWin *win, int x, int y,
 
   QS_ASSERT(win->fadeSurface);
 
+  if(win->phosphor || win->density)
+  {
+    XPoint p;
+    p.x = x;
+    p.y = y;
+    if(win->phosphor)
+      _qsWin_phosphorDrawTracePoints(win, &p, 1,
+          r * RMAX + 0.5F, g * GMAX + 0.5F, b * BMAX + 0.5F);
+    else
+      _qsWin_densityDrawTracePoints(win, &p, 1);
+    return;
+  }
+
   float I; // intensity
   long double t0;
-  struct QsFadingColor *fc, *f;
+  struct QsFadePixel *fp;
+  uint32_t i;
 
-  fc = win->fadeSurface + win->width*y + x;
+  i = win->width*y + x;
+  fp = win->fadeSurface + i;
   t0 = t + win->fadeDelay;
-#ifdef LINEAR_FADE
-  I = _qsWin_fadeIntensity(win->fadePeriod, t0, t);
-#else
-  I =  _qsWin_fadeIntensity(win->fadeAlpha, t0, t);
-#endif
+  I = _qsWin_fadeIntensity(fadeAlpha(win), t0, t);
 
   // If something slowed the running of this program
   // this could happen.  The pixel has faded to zero
   // already.
   if(I < MIN_INTENSITY) return;
 
-  CHECK_LIST(win);
-  /* Remove it from the list if first, because the
-   * chance of it being in the correct position already
-   * is small, and this makes the code simpler. */
-  removeFC(win, fc);
+  fadePush(win, i, fadeTick(win->fadeQueue, t0));
 
-  CHECK_LIST(win);
+  fp->r = r * RMAX + 0.5F; // rounding to integer is required
+  fp->g = g * GMAX + 0.5F;
+  fp->b = b * BMAX + 0.5F;
+  
+  if(I >= 1.0F)
+    setTraceColor(win, getXColor(win, fp->r, fp->g, fp->b));
+  else
+    setTraceColor(win, fadeColor(win, fp, win->width, x, y, I));
 
+  xDrawPoint(win, x, y);
 
-  /* Find where to put it in the list. */
+  // _qsWin_drawPoints(win);// gets called later.
+}
 
-  if(!win->fadeLastInsert)
-    win->fadeLastInsert = win->fadeRear;
+// Like _qsWin_drawTracePoint() but for n points with the same
+// color and time, like a run of pixels in a line.  They all
+// have the same t0, so they all go in the same bucket.
+// All points must be in the view port.
+void _qsWin_drawTracePoints(struct QsWin *win, const XPoint *p, int n,
+    float r, float g, float b, long double t)
+{
+  QS_ASSERT(win);
+  QS_ASSERT(n > 0);
+  QS_ASSERT(r >= 0.0F && r <= 1.0F);
+  QS_ASSERT(g >= 0.0F && g <= 1.0F);
+  QS_ASSERT(b >= 0.0F && b <= 1.0F);
+
+  int i, w;
+  uint8_t R, G, B;
 
-  if(win->fadeLastInsert)
+#ifdef QS_GL
+  if(win->gl)
   {
-    QS_ASSERT(win->fadeRear);
-    QS_ASSERT(win->fadeFront);
+    // OpenGL does the fading.
+    _qsWin_glAddPoints(win, p, n, r, g, b, t);
+    return;
+  }
+#endif
 
-    // look to the rear of the list
-    for(f = win->fadeLastInsert; f && t0 >= f->t0; f = f->prev);
-    if(!f)
-    {
-      QS_ASSERT(t0 >= win->fadeRear->t0);
-      // make it the rear
-      fc->prev = NULL;
-      win->fadeRear->prev = fc;
-      fc->next = win->fadeRear;
-      win->fadeRear = fc;
-//printf("-");
-    }
-    else if(f != win->fadeLastInsert)
-    {
-      // It iterated back in the list
-      // f and f->next are both not NULL
-      QS_ASSERT(f->next);
-      // make it be between f and f->next
-      f->next->prev = fc;
-      fc->next = f->next;
-      fc->prev = f;
-      f->next = fc;
-//printf("^");
-    }
-    else
-    {
-      // look to the front of the list
-      for(; f && t0 < f->t0; f = f->next);
-      if(f)
-      {
-        // t0 >= f->t
-        // make it be between f->prev and f
-        f->prev->next = fc;
-        fc->prev = f->prev;
-        fc->next = f;
-        f->prev = fc;
-//printf("+");
-      }
-      else // !f
-      {
-        QS_ASSERT(t0 < win->fadeFront->t0);
-        // make it the front
-        fc->next = NULL;
-        win->fadeFront->next = fc;
-        fc->prev = win->fadeFront;
-        win->fadeFront = fc;
-//printf("|");
-      }
-    }
+  R = r * RMAX + 0.5F; // rounding to integer is required
+  G = g * GMAX + 0.5F;
+  B = b * BMAX + 0.5F;
+
+  if(!win->fade)
+  {
+    QS_ASSERT(!win->fadeSurface);
+    setTraceColor(win, getXColor(win, R, G, B));
+    for(i = 0; i < n; ++i)
+      xDrawPoint(win, p[i].x, p[i].y);
+    return;
+  }
+
+  QS_ASSERT(win->fadeSurface);
+
+  if(win->phosphor)
+  {
+    _qsWin_phosphorDrawTracePoints(win, p, n, R, G, B);
+    return;
   }
-  else // this one will be the whole list
+  if(win->density)
   {
-    QS_ASSERT(!fc->next && !fc->prev && !win->fadeFront);
-    win->fadeRear = win->fadeFront = fc;
+    _qsWin_densityDrawTracePoints(win, p, n);
+    return;
   }
 
-  fc->t0 = t0;
-  win->fadeLastInsert = fc;
+  float I; // intensity
+  long double t0;
+  uint32_t tick;
+  struct QsFadePixel *fp, *FP;
 
-  CHECK_LIST(win);
+  w = win->width;
+  FP = win->fadeSurface;
+  t0 = t + win->fadeDelay;
+  I = _qsWin_fadeIntensity(fadeAlpha(win), t0, t);
 
-  /* It's in the list in the correct position */
+  if(I < MIN_INTENSITY) return;
+
+  // The ticks are the same in all the tiles.
+  tick = fadeTick(win->fadeQueue, t0);
 
-  fc->r = r * RMAX + 0.5F; // rounding to integer is required
-  fc->g = g * GMAX + 0.5F;
-  fc->b = b * BMAX + 0.5F;
-  
   if(I >= 1.0F)
-    setTraceColor(win, getXColor(win, fc->r, fc->g, fc->b));
-  else
-    setTraceColor(win, fadeColor(win, fc, win->width, x, y, I));
+    setTraceColor(win, getXColor(win, R, G, B));
 
-  xDrawPoint(win, x, y);
+  for(i = 0; i < n; ++i)
+  {
+    uint32_t j;
+    QS_ASSERT(p[i].x >= 0 && p[i].x < w &&
+        p[i].y >= 0 && p[i].y < win->height);
 
-  // _qsWin_drawPoints(win);// gets called later.
+    j = w*p[i].y + p[i].x;
+    fp = FP + j;
+    fadePush(win, j, tick);
+
+    fp->r = R;
+    fp->g = G;
+    fp->b = B;
+
+    if(I < 1.0F)
+      setTraceColor(win, fadeColor(win, fp, w, p[i].x, p[i].y, I));
+    xDrawPoint(win, p[i].x, p[i].y);
+  }
+}
+
+// Fade draw the pixels in the tile with fade queue q at time t.
+// If direct is set this is called from a fade worker thread and we
+// draw straight into the frame buffer; only the pixels of this
+// tile, in win->fadeSurface and win->fb, get written to.
+void _qsWin_fadeDrawTile(struct QsWin *win, struct QsFadeQueue *q,
+    long double t, bool direct)
+{
+  QS_ASSERT(win && q);
+  QS_ASSERT(!direct || (win->fb && win->trueColor));
+
+  if(!q->count) return;
+
+  struct QsFadePixel *FP;
+  float alpha;
+  uint32_t tick, now, front = 0;
+  int w;
+
+  w = win->width;
+  FP = win->fadeSurface;
+  alpha = fadeAlpha(win);
+  now = fadeTick(q, t);
+
+  tick = q->front;
+  // There are only numBuckets buckets to look at.  The buckets of
+  // older ticks get expired in the loop, because they are found
+  // holding a tick older than the one we look for.
+  if(tick < now && now - tick >= q->numBuckets)
+    tick = now - q->numBuckets + 1;
+
+  // Go from the oldest tick to the current tick.  The ticks after
+  // now are at full intensity and are drawn already.
+  for(; tick <= now && q->count; ++tick)
+  {
+    struct QsFadeBucket *bk;
+    float I; // I = trace point color intensity
+    bk = q->bucket + (tick % q->numBuckets);
+
+    if(!bk->len)
+      continue;
+
+    if(bk->tick < tick)
+    {
+      expireBucket(win, q, bk, direct);
+      continue;
+    }
+
+    if(bk->tick > tick)
+      // It's a later tick, that shares the bucket with a tick that
+      // got expired by fadePush().
+      continue;
+
+    // At this time, t, the trace intensity of all the pixels in the
+    // bucket is:
+    I = _qsWin_fadeIntensity(alpha, _qsFadeQueue_tickTime(q, tick), t);
+
+    if(I < MIN_INTENSITY)
+    {
+      // Draw the pixels as the background drawing area color
+      // over the now completely faded trace pixels.
+      expireBucket(win, q, bk, direct);
+      continue;
+    }
+
+    if(!front)
+      front = tick;
+
+    if(I >= 1.0F)
+      // If I is 1 then it's drawn already and so are all the
+      // ticks after it; this is not a redraw.
+      break;
+
+    uint32_t k;
+    for(k = 0; k < bk->len; ++k)
+    {
+      uint32_t i;
+      int x, y;
+      i = bk->index[k];
+      if(FP[i].tick != tick)
+        // stale
+        continue;
+      y = i/w;
+      x = i - y*w;
+      drawPixel(win, q, x, y, fadeColor(win, FP + i, w, x, y, I), direct);
+    }
+  }
+
+  q->front = (front)?front:tick;
 }
 
 // This gets called regularly to fade the beam points.
@@ -246,149 +821,83 @@ bool _qsWin_fadeDraw(struct QsWin *win)
 {
   QS_ASSERT(win);
 
-  if(!win->gc || !win->fadeFront)
+  if(!win->gc || !win->fadeSurface || !_qsWin_fadeIsQueued(win))
     // wait until configure event and something
-    // is in the list:
+    // is in the queue:
     return true;
 
   QS_ASSERT(win->fade && win->fadeSurface);
-  QS_ASSERT((win->fadeFront && win->fadeRear) ||
-      (!win->fadeFront && !win->fadeRear));
-  QS_ASSERT(!win->fadeFront ||
-      (win->fadeFront && !win->fadeFront->next));
-  QS_ASSERT(!win->fadeRear ||
-      (win->fadeRear && !win->fadeRear->prev));
   QS_ASSERT(win->da);
 
-  int w, h, x, y;
+  int w, h, k;
+  long double t;
+
+  w = win->width;
+  h = win->height;
 
   // We can't stop GTK+ from calling this before a needed
   // window configure (resize) event, so we need this check here.
-  w = gtk_widget_get_allocated_width(win->da);
-  h = gtk_widget_get_allocated_height(win->da);
-  if(w != win->width || h != win->height)
+  // A render thread may not call GTK+, and it does not need to,
+  // since _qsWin_cb_configure() pauses it while the size changes.
+  if(!win->render &&
+      (gtk_widget_get_allocated_width(win->da) != w ||
+       gtk_widget_get_allocated_height(win->da) != h))
     /* We need to wait for a resize configure.
      * Yes, this was a fix for a nasty BUG. */
     return true;
 
-  struct QsFadingColor *fc, *FC, *prev;
-  long double t;
-  float alpha, I; // I = trace point color intensity
-#ifdef QS_DEBUG
-  long double lastT0 = SMALL_LDBL;
-#endif
-
-  win->fadeLastTime = t = _qsTimer_get(qsApp->timer);
-#ifdef LINEAR_FADE
-  alpha = win->fadePeriod;
-#else
-  alpha = win->fadeAlpha;
-#endif
-  FC = win->fadeSurface;
+  t = _qsTimer_get(qsApp->timer);
 
-  CHECK_LIST(win);
-
-
-  /* This list contains a list of struct QsFadingColor with increasing
-   * t0, largest at fadeRear and smallest at fadeFront. */
-
-  for(fc = win->fadeFront; fc; fc = prev)
+  if(win->fadeResample)
   {
-    QS_ASSERT(!fc->next);
-
-    prev = fc->prev;
-
-    // At this time, t, the trace intensity at this pixel is:
-    I = _qsWin_fadeIntensity(alpha, fc->t0, t);
-
-#ifdef QS_DEBUG
-    // t0 is not decreasing
-    QS_ASSERT(fc->t0 >= lastT0);
-    lastT0 = fc->t0;
-#endif
-
-    if(I < MIN_INTENSITY)
+    // Some more of the traces from before the last resize.
+    _qsWin_fadeResample(win, false, true);
+    if(!_qsWin_fadeIsQueued(win))
     {
-      int i;
-      // Draw the pixel as the background drawing area color
-      // over the now completely faded trace pixel.
-      y = (fc - FC)/w;
-      x = (fc - FC) - y*w;
-      i = w * y + x;
-      setTraceColor(win, getXColor(win, win->r[i], win->g[i], win->b[i]));
-      xDrawPoint(win, x, y);
-
-      if(win->fadeLastInsert == fc)
-        win->fadeLastInsert = NULL;
-
-      // Remove the point from the front of the list.
-      if(fc->prev)
-      {
-        fc->prev->next = NULL;
-        fc->prev = NULL;
-      }
-      QS_ASSERT(!fc->next);
+      _qsWin_drawPoints(win);
+      return true;
     }
-    else
-      break;
   }
 
-  if(!fc)
+  if(win->phosphor || win->density)
   {
+    // These set win->fadeLastTime.
+    if(win->phosphor)
+      _qsWin_phosphorDraw(win, t);
+    else
+      _qsWin_densityDraw(win, t);
     _qsWin_drawPoints(win);
-    win->fadeFront = win->fadeRear = fc;
-    // All traces are completely faded away.
     return true;
   }
 
-  if(I < 1.0F)
+  win->fadeLastTime = t;
+
+  if(win->fadeThreads)
   {
-    win->fadeFront = fc;
-    
-    // We have I (intensity) already from above
-    // for this first fc element
-    y = (fc - FC)/w;
-    x = (fc - FC) - y*w;
-    setTraceColor(win, fadeColor(win, fc, w, x, y, I));
-    xDrawPoint(win, x, y);
+    QS_ASSERT(win->fb);
+    // Returns after all the tiles are drawn.
+    _qsWin_fadeThreadsRun(win->fadeThreads, t);
 
-    for(fc = fc->prev; fc; fc = fc->prev)
+    // Add the tile dirty rectangles to the frame buffer dirty
+    // rectangle.
+    for(k = 0; k < win->numFadeTiles; ++k)
     {
-      I = _qsWin_fadeIntensity(alpha, fc->t0, t);
-
-      QS_ASSERT(I >= MIN_INTENSITY);
-
-#ifdef QS_DEBUG
-      // t0 is not decreasing
-      QS_ASSERT(fc->t0 >= lastT0);
-      lastT0 = fc->t0;
-#endif
-
-      if(I < 1.0F)
-      {
-        y = (fc - FC)/w;
-        x = (fc - FC) - y*w;
-        setTraceColor(win, fadeColor(win, fc, w, x, y, I));
-        xDrawPoint(win, x, y);
-      }
-      else
-        // If I is 1 or greater than it's drawn already;
-        // this is not a redraw.
-        break;
+      struct QsFadeQueue *q;
+      q = win->fadeQueue + k;
+      if(q->xMax < q->xMin)
+        continue;
+      if(q->xMin < win->fbXMin) win->fbXMin = q->xMin;
+      if(q->xMax > win->fbXMax) win->fbXMax = q->xMax;
+      if(q->yMin < win->fbYMin) win->fbYMin = q->yMin;
+      if(q->yMax > win->fbYMax) win->fbYMax = q->yMax;
+      tileSetClean(q);
     }
-
-  CHECK_LIST(win);
-
-    _qsWin_drawPoints(win);
-  }
-  else if(win->fadeFront != fc)
-  {
-    win->fadeFront = fc;
-    _qsWin_drawPoints(win);
   }
+  else
+    for(k = 0; k < win->numFadeTiles; ++k)
+      _qsWin_fadeDrawTile(win, win->fadeQueue + k, t, false);
 
-  // There is no need to redraw unfaded pixels with I >= 1
-  // because they are drawn already.
+  _qsWin_drawPoints(win);
 
   return true;
 }
@@ -402,41 +911,65 @@ bool _qsWin_fadeDraw(struct QsWin *win)
 void _qsWin_traceFadeRedraws(struct QsWin *win)
 {
   QS_ASSERT(win && win->fade && win->fadeSurface);
+
+  if(win->phosphor || win->density)
+  {
+    if(win->phosphor)
+      _qsWin_phosphorRedraw(win);
+    else
+      _qsWin_densityRedraw(win);
+    _qsWin_drawPoints(win);
+    return;
+  }
   
-  int w;
+  int w, tile;
   float alpha;
-#ifdef LINEAR_FADE
-  alpha = win->fadePeriod;
-#else
-  alpha = win->fadeAlpha;
-#endif
   long double lastTime = win->fadeLastTime;
+  struct QsFadePixel *FP;
+
+  alpha = fadeAlpha(win);
   w = win->width;
-  struct QsFadingColor *fc, *FC;
-  FC = win->fadeSurface;
-  for(fc = win->fadeFront; fc; fc = fc->prev)
-  {
-    int x, y;
-    float I;
-    y = (fc - FC)/w;
-    x = (fc - FC) - y*w;
-    I = _qsWin_fadeIntensity(alpha, fc->t0, lastTime);
-    /* Because we are using fadeLastTime the intensities
-     * should not have changed since the last call to 
-     * _qsWin_fadeDraw() and so: */
-    QS_ASSERT(I >= MIN_INTENSITY);
-
-    /* ??? Given that the fade pixel list is ordered, would it be
-     * much faster to split this for loop into two for loops:
-     * first one for I < 1 and the second one continuing after
-     * for the rest of the list I >= 1, then there would be no
-     * if's in the second loop.  This here may be better. */
-    if(I >= 1.0F)
-      setTraceColor(win, getXColor(win, fc->r, fc->g, fc->b));
-    else
-      setTraceColor(win, fadeColor(win, fc, w, x, y, I));
-    xDrawPoint(win, x, y);
+  FP = win->fadeSurface;
+
+  for(tile = 0; tile < win->numFadeTiles; ++tile)
+  {
+    struct QsFadeQueue *q;
+    uint32_t n;
+    q = win->fadeQueue + tile;
+
+    // The order of the buckets does not matter here; a pixel is only
+    // live in one bucket.
+    for(n = 0; n < q->numBuckets; ++n)
+    {
+      struct QsFadeBucket *bk;
+      uint32_t k;
+      float I;
+      bk = q->bucket + n;
+      if(!bk->len) continue;
+
+      I = _qsWin_fadeIntensity(alpha,
+          _qsFadeQueue_tickTime(q, bk->tick), lastTime);
+      /* It may be faded out since the last call to _qsWin_fadeDraw()
+       * because of a later fade parameter change.  If so the next
+       * _qsWin_fadeDraw() will expire it. */
+      if(I < MIN_INTENSITY) continue;
+
+      for(k = 0; k < bk->len; ++k)
+      {
+        uint32_t i;
+        int x, y;
+        i = bk->index[k];
+        if(FP[i].tick != bk->tick)
+          continue;
+        y = i/w;
+        x = i - y*w;
+        if(I >= 1.0F)
+          setTraceColor(win, getXColor(win, FP[i].r, FP[i].g, FP[i].b));
+        else
+          setTraceColor(win, fadeColor(win, FP + i, w, x, y, I));
+        xDrawPoint(win, x, y);
+      }
+    }
   }
   _qsWin_drawPoints(win);
 }
-
@@ -0,0 +1,172 @@
+/* Quickscope - a software oscilloscope
+ * Copyright (C) 2012-2014  Lance Arsenault
+ * GNU General Public License version 3
+ */
+
+// A pool of worker threads that fade draw the tiles of a window in
+// parallel.  The tiles are rows of the drawing area, each with its
+// own fade queue and dirty rectangle, so the threads never write to
+// the same memory.  They draw straight into the frame buffer, so we
+// only use them with the frame buffer back end.
+//
+// _qsWin_fadeThreadsRun() wakes the workers, fade draws tiles in the
+// calling thread too, and returns after all the tiles are drawn, so
+// the main loop sees nothing change outside of that call.
+
+#include <math.h>
+#include <string.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <X11/Xlib.h>
+#include <gtk/gtk.h>
+#include "debug.h"
+#include "Assert.h"
+#include "base.h"
+#include "app.h"
+#include "adjuster.h"
+#include "adjuster_priv.h"
+#include "win.h"
+#include "win_priv.h"
+
+
+struct QsFadeThreads
+{
+  struct QsWin *win;
+  GThread **thread;
+  int numThreads;
+
+  GMutex mutex;
+  GCond startCond, doneCond;
+  // These are protected by the mutex.
+  guint generation; // counts the calls to _qsWin_fadeThreadsRun()
+  int tilesLeft; // number of tiles not drawn yet
+  bool quit;
+
+  long double t; // fade draw time
+  volatile gint nextTile; // next tile to take, with g_atomic_int_add()
+};
+
+
+// Take tiles and draw them until there are no more.
+static
+void drawTiles(struct QsFadeThreads *ft)
+{
+  struct QsWin *win;
+  int k, done = 0;
+  win = ft->win;
+
+  // g_atomic_int_add() is a memory barrier so we see ft->t from the
+  // same _qsWin_fadeThreadsRun() that reset nextTile.
+  while((k = g_atomic_int_add(&ft->nextTile, 1)) < win->numFadeTiles)
+  {
+    _qsWin_fadeDrawTile(win, win->fadeQueue + k, ft->t, true);
+    ++done;
+  }
+
+  if(!done) return;
+
+  g_mutex_lock(&ft->mutex);
+  ft->tilesLeft -= done;
+  QS_ASSERT(ft->tilesLeft >= 0);
+  if(!ft->tilesLeft)
+    g_cond_signal(&ft->doneCond);
+  g_mutex_unlock(&ft->mutex);
+}
+
+static
+gpointer fadeThread(struct QsFadeThreads *ft)
+{
+  guint generation = 0;
+
+  g_mutex_lock(&ft->mutex);
+  while(true)
+  {
+    while(ft->generation == generation && !ft->quit)
+      g_cond_wait(&ft->startCond, &ft->mutex);
+    if(ft->quit)
+      break;
+    generation = ft->generation;
+    g_mutex_unlock(&ft->mutex);
+
+    drawTiles(ft);
+
+    g_mutex_lock(&ft->mutex);
+  }
+  g_mutex_unlock(&ft->mutex);
+
+  return NULL;
+}
+
+struct QsFadeThreads *_qsWin_fadeThreadsCreate(struct QsWin *win,
+    int numThreads)
+{
+  QS_ASSERT(win);
+  QS_ASSERT(numThreads > 0);
+
+  struct QsFadeThreads *ft;
+  int i;
+
+  ft = g_malloc0(sizeof(*ft));
+  ft->win = win;
+  ft->numThreads = numThreads;
+  // So that no tiles are taken until the first run.
+  ft->nextTile = INT_MAX/2;
+  g_mutex_init(&ft->mutex);
+  g_cond_init(&ft->startCond);
+  g_cond_init(&ft->doneCond);
+
+  ft->thread = g_malloc(sizeof(*ft->thread)*numThreads);
+  for(i = 0; i < numThreads; ++i)
+    ft->thread[i] = g_thread_new("QsFadeThread",
+        (GThreadFunc) fadeThread, ft);
+
+  return ft;
+}
+
+void _qsWin_fadeThreadsDestroy(struct QsFadeThreads *ft)
+{
+  QS_ASSERT(ft);
+  int i;
+
+  g_mutex_lock(&ft->mutex);
+  ft->quit = true;
+  g_cond_broadcast(&ft->startCond);
+  g_mutex_unlock(&ft->mutex);
+
+  for(i = 0; i < ft->numThreads; ++i)
+    g_thread_join(ft->thread[i]);
+
+  g_free(ft->thread);
+  g_cond_clear(&ft->startCond);
+  g_cond_clear(&ft->doneCond);
+  g_mutex_clear(&ft->mutex);
+#ifdef QS_DEBUG
+  memset(ft, 0, sizeof(*ft));
+#endif
+  g_free(ft);
+}
+
+// Fade draw all the tiles at time t, and wait for them to finish.
+void _qsWin_fadeThreadsRun(struct QsFadeThreads *ft, long double t)
+{
+  QS_ASSERT(ft);
+  QS_ASSERT(ft->win->fb);
+
+  g_mutex_lock(&ft->mutex);
+  QS_ASSERT(ft->tilesLeft == 0);
+  ft->t = t;
+  ft->tilesLeft = ft->win->numFadeTiles;
+  g_atomic_int_set(&ft->nextTile, 0);
+  ++ft->generation;
+  g_cond_broadcast(&ft->startCond);
+  g_mutex_unlock(&ft->mutex);
+
+  // We draw too, and not just wait.
+  drawTiles(ft);
+
+  g_mutex_lock(&ft->mutex);
+  while(ft->tilesLeft)
+    g_cond_wait(&ft->doneCond, &ft->mutex);
+  g_mutex_unlock(&ft->mutex);
+}
@@ -0,0 +1,290 @@
+/* Quickscope - a software oscilloscope
+ * Copyright (C) 2012-2014  Lance Arsenault
+ * GNU General Public License version 3
+ */
+
+// The frame buffer drawing back end.  Instead of sending X11 a
+// XSetForeground() and XDrawPoints() request for every run of
+// pixels with the same color, we keep the whole drawing area image
+// in this process and write pixels into it.  At the end of a trace
+// draw we send X11 just the dirty rectangle with one XShmPutImage()
+// (or XPutImage() if there is no MIT-SHM, like with a remote
+// display).
+//
+// We only do this with 24 and 32 bit TrueColor visuals with 8 bits
+// per color, which is about all visuals now days.
+
+#include <limits.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+#include "debug.h"
+#include "Assert.h"
+#include "base.h"
+#include "app.h"
+#include "adjuster.h"
+#include "adjuster_priv.h"
+#include "win.h"
+#include "win_priv.h"
+
+
+struct QsFrameBuffer
+{
+  XImage *image;
+  XShmSegmentInfo shmInfo;
+  bool shm; // using MIT-SHM
+};
+
+
+static inline
+void fbSetClean(struct QsWin *win)
+{
+  win->fbXMin = INT_MAX;
+  win->fbYMin = INT_MAX;
+  win->fbXMax = -1;
+  win->fbYMax = -1;
+}
+
+static
+bool visualIsOkay(Visual *visual, int depth)
+{
+  return (visual->class == TrueColor &&
+      (depth == 24 || depth == 32) &&
+      visual->red_mask == 0xFF0000 &&
+      visual->green_mask == 0x00FF00 &&
+      visual->blue_mask == 0x0000FF);
+}
+
+static
+XImage *createShmImage(struct QsWin *win, struct QsFrameBuffer *fb,
+    Visual *visual, int depth, int w, int h)
+{
+  XImage *image;
+
+  if(!XShmQueryExtension(win->dsp))
+    return NULL;
+
+  image = XShmCreateImage(win->dsp, visual, depth, ZPixmap, NULL,
+      &fb->shmInfo, w, h);
+  if(!image)
+    return NULL;
+
+  fb->shmInfo.shmid = shmget(IPC_PRIVATE, image->bytes_per_line * h,
+      IPC_CREAT | 0600);
+  if(fb->shmInfo.shmid == -1)
+  {
+    XDestroyImage(image);
+    return NULL;
+  }
+
+  fb->shmInfo.shmaddr = image->data = shmat(fb->shmInfo.shmid, NULL, 0);
+  if(fb->shmInfo.shmaddr == (char *) -1)
+  {
+    shmctl(fb->shmInfo.shmid, IPC_RMID, NULL);
+    image->data = NULL;
+    XDestroyImage(image);
+    return NULL;
+  }
+  fb->shmInfo.readOnly = False;
+
+  // XShmAttach() fails with an X11 error, not a return value, if the
+  // X server can't get at our shared memory, like if it's remote.
+  GdkDisplay *gdsp;
+  gdsp = gdk_display_get_default();
+  gdk_x11_display_error_trap_push(gdsp);
+  XShmAttach(win->dsp, &fb->shmInfo);
+  XSync(win->dsp, False);
+  // Mark it for removal now, so it goes away even if we crash.
+  shmctl(fb->shmInfo.shmid, IPC_RMID, NULL);
+
+  if(gdk_x11_display_error_trap_pop(gdsp))
+  {
+    shmdt(fb->shmInfo.shmaddr);
+    image->data = NULL;
+    XDestroyImage(image);
+    return NULL;
+  }
+
+  fb->shm = true;
+  return image;
+}
+
+static
+void destroyImage(struct QsWin *win, struct QsFrameBuffer *fb)
+{
+  QS_ASSERT(fb->image);
+
+  if(fb->shm)
+  {
+    XShmDetach(win->dsp, &fb->shmInfo);
+    XSync(win->dsp, False);
+    shmdt(fb->shmInfo.shmaddr);
+  }
+  else
+    g_free(fb->image->data);
+
+  // So XDestroyImage() does not free() the data.
+  fb->image->data = NULL;
+  XDestroyImage(fb->image);
+  fb->image = NULL;
+  fb->shm = false;
+}
+
+// Makes (or remakes) the frame buffer at the current window size.
+// Returns true if we are using the frame buffer.  We stop using the
+// X11 pixmap double buffer if we have a frame buffer, because the
+// frame buffer is a better double buffer.
+bool _qsWin_frameBufferCreate(struct QsWin *win)
+{
+  QS_ASSERT(win && win->dsp && win->gc);
+  QS_ASSERT(win->width > 0 && win->height > 0);
+
+  Visual *visual;
+  int depth, w, h;
+  struct QsFrameBuffer *fb;
+
+  visual = DefaultVisual(win->dsp, DefaultScreen(win->dsp));
+  depth = DefaultDepth(win->dsp, DefaultScreen(win->dsp));
+  w = win->width;
+  h = win->height;
+
+  if(!visualIsOkay(visual, depth))
+  {
+    QS_SPEW("The X11 visual is not 8 bit per color TrueColor,"
+        " so we can't use the frame buffer\n");
+    _qsWin_frameBufferDestroy(win);
+    return false;
+  }
+
+  if(!win->frameBuffer)
+    win->frameBuffer = g_malloc0(sizeof(*win->frameBuffer));
+  fb = win->frameBuffer;
+
+  if(fb->image)
+    destroyImage(win, fb);
+
+  fb->image = createShmImage(win, fb, visual, depth, w, h);
+
+  if(!fb->image)
+  {
+    // No MIT-SHM, so we use a plain XImage.
+    char *data;
+    data = g_malloc(4*w*h);
+    fb->image = XCreateImage(win->dsp, visual, depth, ZPixmap, 0,
+        data, w, h, 32, 4*w);
+    if(!fb->image)
+    {
+      g_free(data);
+      _qsWin_frameBufferDestroy(win);
+      return false;
+    }
+  }
+
+  if(fb->image->bits_per_pixel != 32)
+  {
+    _qsWin_frameBufferDestroy(win);
+    return false;
+  }
+
+  QS_SPEW("using %s frame buffer %dx%d\n",
+      fb->shm?"MIT-SHM":"XPutImage", w, h);
+
+  win->fb = (uint32_t *) fb->image->data;
+  win->fbStride = fb->image->bytes_per_line/4;
+
+  if(win->pixmap)
+  {
+    if(win->pixmap != (intptr_t) 1)
+      XFreePixmap(win->dsp, win->pixmap);
+    win->pixmap = 0;
+  }
+
+  _qsWin_frameBufferFill(win, win->bg);
+
+  return true;
+}
+
+void _qsWin_frameBufferDestroy(struct QsWin *win)
+{
+  QS_ASSERT(win);
+
+  if(!win->frameBuffer) return;
+
+  if(win->frameBuffer->image)
+    destroyImage(win, win->frameBuffer);
+  g_free(win->frameBuffer);
+  win->frameBuffer = NULL;
+  win->fb = NULL;
+  win->fbStride = 0;
+  fbSetClean(win);
+}
+
+// Like XFillRectangle() on the whole drawing area.
+void _qsWin_frameBufferFill(struct QsWin *win, unsigned long pixel)
+{
+  QS_ASSERT(win && win->fb);
+  int x, y;
+  uint32_t *row;
+  row = win->fb;
+  for(y = 0; y < win->height; ++y)
+  {
+    for(x = 0; x < win->width; ++x)
+      row[x] = pixel;
+    row += win->fbStride;
+  }
+  _qsWin_frameBufferSetDirty(win);
+}
+
+// Mark the whole frame buffer as needing to be sent to X11,
+// like after an expose event.
+void _qsWin_frameBufferSetDirty(struct QsWin *win)
+{
+  QS_ASSERT(win && win->fb);
+  win->fbXMin = 0;
+  win->fbYMin = 0;
+  win->fbXMax = win->width - 1;
+  win->fbYMax = win->height - 1;
+}
+
+// Send the dirty rectangle to the X server.
+void _qsWin_frameBufferFlush(struct QsWin *win)
+{
+  QS_ASSERT(win && win->fb && win->frameBuffer);
+
+  if(!_qsWin_frameBufferIsDirty(win)) return;
+
+  int x, y, w, h;
+  x = win->fbXMin;
+  y = win->fbYMin;
+  w = win->fbXMax - x + 1;
+  h = win->fbYMax - y + 1;
+
+  // With a render thread (op_renderThread) win->dsp is the render
+  // thread's Display here, not the main one that we did the
+  // XShmAttach() with in createShmImage().  That's okay: the segment
+  // XID in shmInfo.shmseg is an X server resource like a window or a
+  // pixmap, so any client connection may name it.  The XSync() after
+  // the XShmAttach() makes sure the server has it before the render
+  // thread can use it, and we attach and detach only in
+  // _qsWin_cb_configure() and qsWin_destroy() while the render thread
+  // is paused or gone.
+  if(win->frameBuffer->shm)
+    // We do not wait for the completion event.  If we write to the
+    // frame buffer before the X server is done reading it we may
+    // get part of the next frame in this one, and that's just what
+    // a real scope does.
+    XShmPutImage(win->dsp, win->xwin, win->gc, win->frameBuffer->image,
+        x, y, x, y, w, h, False);
+  else
+    XPutImage(win->dsp, win->xwin, win->gc, win->frameBuffer->image,
+        x, y, x, y, w, h);
+
+  fbSetClean(win);
+}
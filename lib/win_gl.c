@@ -0,0 +1,509 @@
+/* Quickscope - a software oscilloscope
+ * Copyright (C) 2012-2014  Lance Arsenault
+ * GNU General Public License version 3
+ */
+
+// The OpenGL drawing back end (op_gl), built with --enable-gl.  The
+// drawing area is a GtkGLArea, and instead of XDrawPoints() the trace
+// points are put in a vertex buffer and drawn as GL_POINTS into a
+// floating point persistence texture.  Fading is one pass over the
+// persistence texture that multiplies it by the decay since the last
+// render, like the phosphor fade engine in win_phosphor.c does on the
+// CPU.  The background planes, from _qsWin_drawBackground(), are a
+// texture that the persistence texture is blended over when we draw
+// to the GtkGLArea.
+//
+// Any GL 3.2 core profile will do, like Mesa llvmpipe, so we can
+// compare this with the libX11 and frame buffer back ends on the same
+// traces.  The swipe does not work with this back end; it needs to
+// erase pixels.
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <epoxy/gl.h>
+#include <X11/Xlib.h>
+#include <gtk/gtk.h>
+#include "debug.h"
+#include "Assert.h"
+#include "base.h"
+#include "timer_priv.h"
+#include "app.h"
+#include "adjuster.h"
+#include "adjuster_priv.h"
+#include "win.h"
+#include "win_priv.h"
+
+
+// The most that one trace draw adds to a pixel's intensity, so that
+// a large fade delay does not blow up the float texture.
+#define MAX_HIT  256.0F
+
+
+struct QsGLVertex
+{
+  GLfloat x, y; // X11 pixel coordinates
+  GLfloat r, g, b, hit;
+};
+
+struct QsGL
+{
+  GtkWidget *area;
+
+  GLuint vao, vbo;
+  GLuint fillProgram, pointProgram, compositeProgram;
+  GLint pointSize, fillDecay, compositeTrace, compositeBg,
+        compositeMinIntensity;
+  GLuint traceTex, fbo, bgTex;
+  int texWidth, texHeight; // 0 if the textures are not made yet
+
+  // Points waiting for the next render.
+  struct QsGLVertex *vert;
+  size_t numVerts, vertAlloc;
+
+  bool bgChanged; // upload win->bgPlane at the next render
+  bool clear; // clear the persistence texture at the next render
+  long double lastRenderTime, lastPointTime;
+};
+
+
+static const char *quadVertexShader =
+"#version 150\n"
+"in vec2 pos;\n"
+"out vec2 uv;\n"
+"void main()\n"
+"{\n"
+"  uv = (pos + 1.0)*0.5;\n"
+"  gl_Position = vec4(pos, 0.0, 1.0);\n"
+"}\n";
+
+static const char *fillFragmentShader =
+"#version 150\n"
+"uniform float decay;\n"
+"out vec4 color;\n"
+"void main()\n"
+"{\n"
+"  // This is a blend constant multiply, see GL_CONSTANT_COLOR.\n"
+"  color = vec4(decay);\n"
+"}\n";
+
+static const char *pointVertexShader =
+"#version 150\n"
+"uniform vec2 size;\n"
+"in vec2 pos;\n"
+"in vec4 colorHit;\n"
+"out vec4 c;\n"
+"void main()\n"
+"{\n"
+"  c = vec4(colorHit.rgb * colorHit.a, colorHit.a);\n"
+"  gl_Position = vec4(2.0*(pos.x + 0.5)/size.x - 1.0,\n"
+"      1.0 - 2.0*(pos.y + 0.5)/size.y, 0.0, 1.0);\n"
+"}\n";
+
+static const char *pointFragmentShader =
+"#version 150\n"
+"in vec4 c;\n"
+"out vec4 color;\n"
+"void main()\n"
+"{\n"
+"  color = c;\n"
+"}\n";
+
+// The persistence texture has the sum of color*intensity in rgb and
+// the intensity in a, so the trace color is rgb/a.
+static const char *compositeFragmentShader =
+"#version 150\n"
+"uniform sampler2D trace;\n"
+"uniform sampler2D bg;\n"
+"uniform float minIntensity;\n"
+"in vec2 uv;\n"
+"out vec4 color;\n"
+"void main()\n"
+"{\n"
+"  vec4 t = texture(trace, uv);\n"
+"  vec3 b = texture(bg, vec2(uv.x, 1.0 - uv.y)).rgb;\n"
+"  if(t.a < minIntensity)\n"
+"    color = vec4(b, 1.0);\n"
+"  else\n"
+"    color = vec4(mix(b, t.rgb/t.a, min(t.a, 1.0)), 1.0);\n"
+"}\n";
+
+
+static
+GLuint compileShader(GLenum type, const char *src)
+{
+  GLuint s;
+  GLint ok;
+  s = glCreateShader(type);
+  glShaderSource(s, 1, &src, NULL);
+  glCompileShader(s);
+  glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+  if(!ok)
+  {
+    char log[1024];
+    glGetShaderInfoLog(s, sizeof(log), NULL, log);
+    QS_VASSERT(0, "GL shader compile failed: %s\n", log);
+    glDeleteShader(s);
+    return 0;
+  }
+  return s;
+}
+
+static
+GLuint makeProgram(const char *vertSrc, const char *fragSrc)
+{
+  GLuint p, v, f;
+  GLint ok;
+
+  v = compileShader(GL_VERTEX_SHADER, vertSrc);
+  f = compileShader(GL_FRAGMENT_SHADER, fragSrc);
+  p = glCreateProgram();
+  glAttachShader(p, v);
+  glAttachShader(p, f);
+  glBindAttribLocation(p, 0, "pos");
+  glBindAttribLocation(p, 1, "colorHit");
+  glLinkProgram(p);
+  glDeleteShader(v);
+  glDeleteShader(f);
+  glGetProgramiv(p, GL_LINK_STATUS, &ok);
+  if(!ok)
+  {
+    char log[1024];
+    glGetProgramInfoLog(p, sizeof(log), NULL, log);
+    QS_VASSERT(0, "GL program link failed: %s\n", log);
+  }
+  return p;
+}
+
+// The trace intensity that one draw adds, like phosphorHit in
+// win_phosphor.c, and the decay rate alpha in I = exp(alpha * t).
+static inline
+float getAlpha(const struct QsWin *win)
+{
+  if(win->fadePeriod > 0.000001F)
+    return logf((float) MIN_INTENSITY)/win->fadePeriod;
+  return -1.0e+7F;
+}
+
+static inline
+float getHit(const struct QsWin *win)
+{
+  float hit;
+  if(!win->fade)
+    return 1.0F;
+  hit = expf(- getAlpha(win) * win->fadeDelay);
+  if(!(hit < MAX_HIT)) // or NAN
+    hit = MAX_HIT;
+  return hit;
+}
+
+static
+void freeTextures(struct QsGL *gl)
+{
+  if(!gl->texWidth) return;
+  glDeleteFramebuffers(1, &gl->fbo);
+  glDeleteTextures(1, &gl->traceTex);
+  glDeleteTextures(1, &gl->bgTex);
+  gl->texWidth = gl->texHeight = 0;
+}
+
+static
+void makeTextures(struct QsGL *gl, int w, int h)
+{
+  freeTextures(gl);
+
+  glGenTextures(1, &gl->traceTex);
+  glBindTexture(GL_TEXTURE_2D, gl->traceTex);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, w, h, 0,
+      GL_RGBA, GL_FLOAT, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  glGenFramebuffers(1, &gl->fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, gl->fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+      GL_TEXTURE_2D, gl->traceTex, 0);
+  QS_VASSERT(glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+      GL_FRAMEBUFFER_COMPLETE, "GL persistence frame buffer is not"
+      " complete\n");
+
+  glGenTextures(1, &gl->bgTex);
+  glBindTexture(GL_TEXTURE_2D, gl->bgTex);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0,
+      GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  gl->texWidth = w;
+  gl->texHeight = h;
+  gl->clear = true;
+  gl->bgChanged = true;
+}
+
+static
+void cb_realize(GtkGLArea *area, struct QsWin *win)
+{
+  struct QsGL *gl;
+  gl = win->gl;
+
+  gtk_gl_area_make_current(area);
+  if(gtk_gl_area_get_error(area))
+  {
+    QS_SPEW("GtkGLArea failed: %s\n", gtk_gl_area_get_error(area)->message);
+    return;
+  }
+
+  gl->fillProgram = makeProgram(quadVertexShader, fillFragmentShader);
+  gl->pointProgram = makeProgram(pointVertexShader, pointFragmentShader);
+  gl->compositeProgram = makeProgram(quadVertexShader,
+      compositeFragmentShader);
+  gl->fillDecay = glGetUniformLocation(gl->fillProgram, "decay");
+  gl->pointSize = glGetUniformLocation(gl->pointProgram, "size");
+  gl->compositeTrace = glGetUniformLocation(gl->compositeProgram, "trace");
+  gl->compositeBg = glGetUniformLocation(gl->compositeProgram, "bg");
+  gl->compositeMinIntensity = glGetUniformLocation(gl->compositeProgram,
+      "minIntensity");
+
+  glGenVertexArrays(1, &gl->vao);
+  glGenBuffers(1, &gl->vbo);
+
+  gl->lastRenderTime = _qsTimer_get(qsApp->timer);
+}
+
+static
+void cb_unrealize(GtkGLArea *area, struct QsWin *win)
+{
+  struct QsGL *gl;
+  gl = win->gl;
+
+  gtk_gl_area_make_current(area);
+  if(gtk_gl_area_get_error(area)) return;
+
+  freeTextures(gl);
+  glDeleteBuffers(1, &gl->vbo);
+  glDeleteVertexArrays(1, &gl->vao);
+  glDeleteProgram(gl->fillProgram);
+  glDeleteProgram(gl->pointProgram);
+  glDeleteProgram(gl->compositeProgram);
+}
+
+// A full drawing area quad.
+static inline
+void drawQuad(struct QsGL *gl)
+{
+  static const GLfloat quad[] = { -1,-1,  1,-1,  -1,1,  1,1 };
+  glBindBuffer(GL_ARRAY_BUFFER, gl->vbo);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STREAM_DRAW);
+  glEnableVertexAttribArray(0);
+  glDisableVertexAttribArray(1);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+static
+gboolean cb_render(GtkGLArea *area, GdkGLContext *context,
+    struct QsWin *win)
+{
+  struct QsGL *gl;
+  long double t;
+  int w, h;
+
+  gl = win->gl;
+  w = win->width;
+  h = win->height;
+
+  if(gtk_gl_area_get_error(area) || w <= 0 || h <= 0 || !win->bgPlane)
+    return TRUE;
+
+  if(gl->texWidth != w || gl->texHeight != h)
+    makeTextures(gl, w, h);
+
+  if(gl->bgChanged)
+  {
+    // win->bgPlane is RGBX with the top row first.
+    glBindTexture(GL_TEXTURE_2D, gl->bgTex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h,
+        GL_RGBA, GL_UNSIGNED_BYTE, win->bgPlane);
+    gl->bgChanged = false;
+  }
+
+  glBindVertexArray(gl->vao);
+  glBindFramebuffer(GL_FRAMEBUFFER, gl->fbo);
+  glViewport(0, 0, w, h);
+
+  t = _qsTimer_get(qsApp->timer);
+
+  if(gl->clear)
+  {
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    gl->clear = false;
+  }
+  else if(win->fade && !qsApp->freezeDisplay)
+  {
+    // The fade pass: trace *= exp(alpha * dt)
+    float d;
+    d = expf(getAlpha(win) * (float) (t - gl->lastRenderTime));
+    glUseProgram(gl->fillProgram);
+    glUniform1f(gl->fillDecay, d);
+    glEnable(GL_BLEND);
+    glBlendColor(d, d, d, d);
+    glBlendFunc(GL_ZERO, GL_CONSTANT_COLOR);
+    drawQuad(gl);
+  }
+  gl->lastRenderTime = t;
+
+  if(gl->numVerts)
+  {
+    // The points add to what is there.
+    glUseProgram(gl->pointProgram);
+    glUniform2f(gl->pointSize, w, h);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glBindBuffer(GL_ARRAY_BUFFER, gl->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(*gl->vert)*gl->numVerts,
+        gl->vert, GL_STREAM_DRAW);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(*gl->vert),
+        (void *) offsetof(struct QsGLVertex, x));
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(*gl->vert),
+        (void *) offsetof(struct QsGLVertex, r));
+    glDrawArrays(GL_POINTS, 0, gl->numVerts);
+    gl->numVerts = 0;
+  }
+  glDisable(GL_BLEND);
+
+  // Now the trace over the background into the GtkGLArea buffer.
+  gtk_gl_area_attach_buffers(area);
+  glViewport(0, 0, w, h);
+  glUseProgram(gl->compositeProgram);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, gl->traceTex);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, gl->bgTex);
+  glUniform1i(gl->compositeTrace, 0);
+  glUniform1i(gl->compositeBg, 1);
+  glUniform1f(gl->compositeMinIntensity, MIN_INTENSITY);
+  drawQuad(gl);
+  glActiveTexture(GL_TEXTURE0);
+
+  return TRUE;
+}
+
+static
+void cb_resize(GtkGLArea *area, gint width, gint height, struct QsWin *win)
+{
+  _qsWin_cb_configure(GTK_WIDGET(area), NULL, win);
+}
+
+// Makes the GtkGLArea drawing area widget for the window.
+GtkWidget *_qsWin_glCreate(struct QsWin *win)
+{
+  QS_ASSERT(win);
+  QS_ASSERT(!win->gl);
+
+  struct QsGL *gl;
+
+  win->gl = gl = g_malloc0(sizeof(*gl));
+  gl->area = gtk_gl_area_new();
+  gtk_gl_area_set_required_version(GTK_GL_AREA(gl->area), 3, 2);
+  gtk_gl_area_set_has_alpha(GTK_GL_AREA(gl->area), FALSE);
+
+  g_signal_connect(G_OBJECT(gl->area), "realize",
+      G_CALLBACK(cb_realize), win);
+  g_signal_connect(G_OBJECT(gl->area), "unrealize",
+      G_CALLBACK(cb_unrealize), win);
+  g_signal_connect(G_OBJECT(gl->area), "render",
+      G_CALLBACK(cb_render), win);
+  g_signal_connect(G_OBJECT(gl->area), "resize",
+      G_CALLBACK(cb_resize), win);
+
+  return gl->area;
+}
+
+// The widget is destroyed with the window.
+void _qsWin_glDestroy(struct QsWin *win)
+{
+  QS_ASSERT(win);
+  struct QsGL *gl;
+  gl = win->gl;
+  if(!gl) return;
+
+  if(gl->vert)
+    g_free(gl->vert);
+#ifdef QS_DEBUG
+  memset(gl, 0, sizeof(*gl));
+#endif
+  g_free(gl);
+  win->gl = NULL;
+}
+
+// Queue n trace points to be drawn at the next render.  r, g, b are
+// from 0 to 1.
+void _qsWin_glAddPoints(struct QsWin *win, const XPoint *p, int n,
+    float r, float g, float b, long double t)
+{
+  QS_ASSERT(win && win->gl);
+  QS_ASSERT(n > 0);
+
+  struct QsGL *gl;
+  struct QsGLVertex *v;
+  float hit;
+  int k;
+
+  gl = win->gl;
+
+  if(gl->numVerts + n > gl->vertAlloc)
+  {
+    // It only grows to what the traces draw between renders.
+    gl->vertAlloc = 2*(gl->numVerts + n);
+    gl->vert = g_realloc(gl->vert, sizeof(*gl->vert)*gl->vertAlloc);
+  }
+
+  hit = getHit(win);
+  v = gl->vert + gl->numVerts;
+  for(k = 0; k < n; ++k, ++v)
+  {
+    v->x = p[k].x;
+    v->y = p[k].y;
+    v->r = r;
+    v->g = g;
+    v->b = b;
+    v->hit = hit;
+  }
+  gl->numVerts += n;
+  gl->lastPointTime = t;
+}
+
+// Called when win->bgPlane changes.
+void _qsWin_glBackgroundChanged(struct QsWin *win)
+{
+  QS_ASSERT(win && win->gl);
+  win->gl->bgChanged = true;
+  if(!win->fade)
+    // Without fading the points stay until the background is drawn.
+    win->gl->clear = true;
+  gtk_gl_area_queue_render(GTK_GL_AREA(win->gl->area));
+}
+
+// Like _qsWin_postTraceDraw(), we render if there are new points or
+// if the traces are still fading.
+void _qsWin_glPostTraceDraw(struct QsWin *win, long double t)
+{
+  QS_ASSERT(win && win->gl);
+  struct QsGL *gl;
+  gl = win->gl;
+
+  if(qsApp->freezeDisplay)
+    return;
+
+  if(gl->numVerts || (win->fade &&
+        t < gl->lastPointTime + win->fadeDelay + win->fadePeriod &&
+        t >= gl->lastRenderTime + win->fadeMaxDrawPeriod))
+    gtk_gl_area_queue_render(GTK_GL_AREA(gl->area));
+}
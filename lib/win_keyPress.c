@@ -20,6 +20,7 @@
 #include "Assert.h"
 #include "base.h"
 #include "app.h"
+#include "app_priv.h"
 #include "adjuster.h"
 #include "adjuster_priv.h"
 #include "win.h"
@@ -321,6 +322,7 @@ bool ecb_keyPress(GtkWidget *w, GdkEvent *e, struct QsWin *win)
       break;
     case GDK_KEY_Z:
     case GDK_KEY_z:
+      _qsApp_renderPause();
       qsApp->freezeDisplay = qsApp->freezeDisplay?false:true;
       if(!qsApp->freezeDisplay)
       {
@@ -328,6 +330,7 @@ bool ecb_keyPress(GtkWidget *w, GdkEvent *e, struct QsWin *win)
         for(l=qsApp->wins; l; l=l->next)
           _qsWin_unfreeze((struct QsWin *) l->data);
       }
+      _qsApp_renderResume();
       return true;
       break;
     case GDK_KEY_Q:
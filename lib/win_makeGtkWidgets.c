@@ -68,7 +68,15 @@ bool cb_close(GtkWidget *w, GdkEvent *e, struct QsWin *win)
 static
 bool _qsWin_cbDraw(GtkWidget *da, cairo_t *cr, struct QsWin *win)
 {
-  if(win->pixmap)
+  _qsWin_renderPause(win);
+
+  if(win->fb)
+  {
+    // The frame buffer has the whole image in it.
+    _qsWin_frameBufferSetDirty(win);
+    _qsWin_frameBufferFlush(win);
+  }
+  else if(win->pixmap)
   {
     static int count = 0;
     ++count;
@@ -77,7 +85,7 @@ bool _qsWin_cbDraw(GtkWidget *da, cairo_t *cr, struct QsWin *win)
   }
   else
   {
-    setTraceColor(win, win->bg);
+    _qsWin_setXForeground(win, win->bg);
     XFillRectangle(win->dsp, win->xwin, win->gc, 0, 0,
         win->width, win->height);
     _qsWin_drawBackground(win);
@@ -93,6 +101,8 @@ bool _qsWin_cbDraw(GtkWidget *da, cairo_t *cr, struct QsWin *win)
     // then we can't draw traces in this GTK draw callback.
   }
 
+  _qsWin_renderResume(win);
+
   return true; /* true means the event is handled. */
 }
 
@@ -478,7 +488,14 @@ void _qsWin_makeGtkWidgets(struct QsWin *win)
      **************************************************************************/
     {
       GtkWidget *da;
-      win->da = da = gtk_drawing_area_new();
+#ifdef QS_GL
+      if(qsApp->op_gl)
+        // It gets its configure from the GtkGLArea "resize"
+        // signal and draws in the "render" signal.
+        win->da = da = _qsWin_glCreate(win);
+      else
+#endif
+        win->da = da = gtk_drawing_area_new();
       // TODO: gtk_widget_set_double_buffered(,false) is depreciated
       // but we still need what it did.
       // We don't want GTK to double buffer, because we are doing
@@ -491,17 +508,21 @@ void _qsWin_makeGtkWidgets(struct QsWin *win)
       // there is no "proper" work-around to keep GTK from clobbering things
       // you draw without cairo (Thu Nov 20 12:49:22 EST 2014).
       // Calling gtk_widget_set_double_buffered() is the best I can do.
-      gtk_widget_set_double_buffered(da, false);
+      if(!win->gl)
+        gtk_widget_set_double_buffered(da, false);
       gtk_widget_set_events(da,
                   gtk_widget_get_events(da) |
 		  GDK_BUTTON_PRESS_MASK |
 		  GDK_BUTTON_RELEASE_MASK |
 		  GDK_POINTER_MOTION_MASK);
 
-      g_signal_connect(G_OBJECT(da),"configure-event",
-          G_CALLBACK(_qsWin_cb_configure), win);
-      g_signal_connect(G_OBJECT(da), "draw",
-          G_CALLBACK(_qsWin_cbDraw), win);
+      if(!win->gl)
+      {
+        g_signal_connect(G_OBJECT(da),"configure-event",
+            G_CALLBACK(_qsWin_cb_configure), win);
+        g_signal_connect(G_OBJECT(da), "draw",
+            G_CALLBACK(_qsWin_cbDraw), win);
+      }
       g_signal_connect(G_OBJECT(da), "button-press-event",
           G_CALLBACK(ecbButtonPress), win);
       g_signal_connect(G_OBJECT(da), "button-release-event",
@@ -0,0 +1,278 @@
+/* Quickscope - a software oscilloscope
+ * Copyright (C) 2012-2014  Lance Arsenault
+ * GNU General Public License version 3
+ */
+
+// The phosphor fade engine, QS_FADE_PHOSPHOR.  Each pixel has a trace
+// intensity, and at every fade draw we multiply all the intensities in
+// the lit rectangle by the same decay, exp(alpha * dt), which gives an
+// exponential fade with no expf() per pixel and no queue of pixels.
+// A pixel goes back to the background when its intensity is less than
+// MIN_INTENSITY.
+//
+// A trace draw adds phosphorHit to the pixel intensity, and the color
+// is at full intensity until it decays to less than 1, so a trace
+// that draws over the same pixels again and again stays lit longer,
+// like on a real scope.  phosphorHit is the intensity that takes the
+// fade delay to decay to 1.
+
+#include <math.h>
+#include <string.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <X11/Xlib.h>
+#include <gtk/gtk.h>
+#if defined(__AVX__)
+#  include <immintrin.h>
+#elif defined(__SSE__)
+#  include <xmmintrin.h>
+#endif
+#include "debug.h"
+#include "Assert.h"
+#include "base.h"
+#include "timer_priv.h"
+#include "app.h"
+#include "adjuster.h"
+#include "adjuster_priv.h"
+#include "win.h"
+#include "win_priv.h"
+
+
+// The most intensity a pixel can get to, in number of trace draws.
+#define MAX_HITS  8.0F
+// So that phosphorMax stays finite with a large fade delay.
+#define MAX_HIT   1.0e+6F
+
+
+static inline
+void setClean(struct QsWin *win)
+{
+  win->phXMin = win->phYMin = INT_MAX;
+  win->phXMax = win->phYMax = -1;
+}
+
+// Returns the decay rate, alpha, in I = exp(alpha * t).
+static inline
+float getAlpha(const struct QsWin *win)
+{
+  if(win->fadePeriod > 0.000001F)
+    return logf((float) MIN_INTENSITY)/win->fadePeriod;
+  // The fade period is very small, so we act like it's zero.
+  return -1.0e+7F;
+}
+
+// I[k] *= d for k in [0, n)
+static inline
+void decay(float *I, int n, float d)
+{
+  int k = 0;
+#if defined(__AVX__)
+  {
+    const __m256 D = _mm256_set1_ps(d);
+    for(; k + 8 <= n; k += 8)
+      _mm256_storeu_ps(&I[k], _mm256_mul_ps(_mm256_loadu_ps(&I[k]), D));
+  }
+#elif defined(__SSE__)
+  {
+    const __m128 D = _mm_set1_ps(d);
+    for(; k + 4 <= n; k += 4)
+      _mm_storeu_ps(&I[k], _mm_mul_ps(_mm_loadu_ps(&I[k]), D));
+  }
+#endif
+  for(; k < n; ++k)
+    I[k] *= d;
+}
+
+// The fade surface must be made already.
+void _qsWin_phosphorInit(struct QsWin *win)
+{
+  QS_ASSERT(win && win->fadeSurface);
+  QS_ASSERT(!win->phosphor);
+  QS_ASSERT(win->width > 0 && win->height > 0);
+
+  win->phosphor = g_malloc0(sizeof(*win->phosphor)*
+      win->width*win->height);
+  setClean(win);
+  _qsWin_phosphorSetParams(win);
+  win->fadeLastTime = _qsTimer_get(qsApp->timer);
+}
+
+void _qsWin_phosphorCleanup(struct QsWin *win)
+{
+  QS_ASSERT(win);
+
+  if(win->phosphor)
+    g_free(win->phosphor);
+  win->phosphor = NULL;
+  setClean(win);
+}
+
+// Call this when the fade period or delay changes.
+void _qsWin_phosphorSetParams(struct QsWin *win)
+{
+  QS_ASSERT(win);
+  float hit;
+
+  hit = expf(- getAlpha(win) * win->fadeDelay);
+  if(!(hit < MAX_HIT)) // or NAN
+    hit = MAX_HIT;
+  win->phosphorHit = hit;
+  win->phosphorMax = MAX_HITS * hit;
+}
+
+// All points must be in the view port.  r, g, b are from 0 to RMAX,
+// GMAX, BMAX.
+void _qsWin_phosphorDrawTracePoints(struct QsWin *win, const XPoint *p,
+    int n, uint8_t r, uint8_t g, uint8_t b)
+{
+  QS_ASSERT(win && win->phosphor && win->fadeSurface);
+  QS_ASSERT(n > 0);
+
+  struct QsFadePixel *FP;
+  float *I, hit, max;
+  int k, w;
+
+  FP = win->fadeSurface;
+  I = win->phosphor;
+  w = win->width;
+  hit = win->phosphorHit;
+  max = win->phosphorMax;
+
+  if(win->phXMax < win->phXMin)
+    // Nothing is lit, so _qsWin_phosphorDraw() has not been called
+    // and fadeLastTime may be old.  We don't want the decay of all
+    // that idle time put on these new hits.
+    win->fadeLastTime = _qsTimer_get(qsApp->timer);
+
+  setTraceColor(win, getXColor(win, r, g, b));
+
+  for(k = 0; k < n; ++k)
+  {
+    int x, y;
+    uint32_t i;
+    x = p[k].x;
+    y = p[k].y;
+    QS_ASSERT(x >= 0 && x < w && y >= 0 && y < win->height);
+    i = w*y + x;
+
+    if(!FP[i].tick)
+      // It was swiped or never lit.
+      I[i] = 0.0F;
+    I[i] += hit;
+    if(I[i] > max)
+      I[i] = max;
+
+    FP[i].tick = 1;
+    FP[i].r = r;
+    FP[i].g = g;
+    FP[i].b = b;
+
+    if(x < win->phXMin) win->phXMin = x;
+    if(x > win->phXMax) win->phXMax = x;
+    if(y < win->phYMin) win->phYMin = y;
+    if(y > win->phYMax) win->phYMax = y;
+
+    xDrawPoint(win, x, y);
+  }
+}
+
+// Decay all the lit pixels from the last fade draw time to time t,
+// and redraw the ones that changed color.
+void _qsWin_phosphorDraw(struct QsWin *win, long double t)
+{
+  QS_ASSERT(win && win->phosphor && win->fadeSurface);
+
+  struct QsFadePixel *FP;
+  float d;
+  int x, y, w, xMin, yMin, xMax, yMax;
+
+  d = expf(getAlpha(win) * (float) (t - win->fadeLastTime));
+  win->fadeLastTime = t;
+
+  if(win->phXMax < win->phXMin)
+    return;
+
+  FP = win->fadeSurface;
+  w = win->width;
+  xMin = win->phXMin;
+  xMax = win->phXMax;
+  yMin = win->phYMin;
+  yMax = win->phYMax;
+  setClean(win);
+
+  for(y = yMin; y <= yMax; ++y)
+  {
+    float *I;
+    struct QsFadePixel *fp;
+    I = win->phosphor + w*y;
+    fp = FP + w*y;
+
+    decay(I + xMin, xMax - xMin + 1, d);
+
+    for(x = xMin; x <= xMax; ++x)
+    {
+      if(I[x] == 0.0F)
+        continue;
+
+      if(!fp[x].tick)
+      {
+        // It got swiped.
+        I[x] = 0.0F;
+        continue;
+      }
+
+      if(I[x] < MIN_INTENSITY)
+      {
+        uint32_t i;
+        i = w*y + x;
+        I[x] = 0.0F;
+        fp[x].tick = 0;
+        setTraceColor(win, bgPlaneColor(win, i));
+        xDrawPoint(win, x, y);
+        continue;
+      }
+
+      // It's still lit.
+      if(x < win->phXMin) win->phXMin = x;
+      if(x > win->phXMax) win->phXMax = x;
+      if(y < win->phYMin) win->phYMin = y;
+      if(y > win->phYMax) win->phYMax = y;
+
+      if(I[x] < 1.0F)
+      {
+        setTraceColor(win, fadeColor(win, fp + x, w, x, y, I[x]));
+        xDrawPoint(win, x, y);
+      }
+    }
+  }
+}
+
+// Like _qsWin_traceFadeRedraws(), draw the lit pixels without adding
+// any decay.
+void _qsWin_phosphorRedraw(struct QsWin *win)
+{
+  QS_ASSERT(win && win->phosphor && win->fadeSurface);
+
+  struct QsFadePixel *FP;
+  int x, y, w;
+
+  FP = win->fadeSurface;
+  w = win->width;
+
+  for(y = win->phYMin; y <= win->phYMax; ++y)
+    for(x = win->phXMin; x <= win->phXMax; ++x)
+    {
+      uint32_t i;
+      float I;
+      i = w*y + x;
+      I = win->phosphor[i];
+      if(!FP[i].tick || I < MIN_INTENSITY)
+        continue;
+      if(I >= 1.0F)
+        setTraceColor(win, getXColor(win, FP[i].r, FP[i].g, FP[i].b));
+      else
+        setTraceColor(win, fadeColor(win, FP + i, w, x, y, I));
+      xDrawPoint(win, x, y);
+    }
+}
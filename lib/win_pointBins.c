@@ -0,0 +1,214 @@
+/* Quickscope - a software oscilloscope
+ * Copyright (C) 2012-2014  Lance Arsenault
+ * GNU General Public License version 3
+ */
+
+// Points that are waiting to be drawn with XDrawPoints() are tagged
+// with a bin for their X11 pixel color, so that a fade pass, that
+// changes color at almost every pixel, does not send the X server
+// lots of XSetForeground() and XDrawPoints() requests with 1 to 3
+// points in them.  When they are flushed by _qsWin_drawPoints() we
+// counting sort the points by bin and draw them with one
+// XDrawPoints() per color.
+//
+// The point buffer is allocated at window resize and is flushed when
+// it's full, so drawing never allocates memory.
+//
+// Since the bins are drawn in any order, a pixel that is drawn more
+// than once before a flush could get the wrong color, so we keep
+// a stamp for each pixel with the sequence number of the last point
+// drawn at that pixel, and skip the points that are not the last.
+
+#include <inttypes.h>
+#include <string.h>
+#include <stdbool.h>
+#include <X11/Xlib.h>
+#include <gtk/gtk.h>
+#include "debug.h"
+#include "Assert.h"
+#include "base.h"
+#include "app.h"
+#include "adjuster.h"
+#include "adjuster_priv.h"
+#include "win.h"
+#include "win_priv.h"
+
+
+// The hash table size must be a power of 2 and larger than
+// QS_MAX_POINT_BINS so that it never gets too full.
+#define TABLE_SIZE  (QS_MAX_POINT_BINS * 2)
+
+
+static inline
+uint32_t hashPixel(unsigned long pixel)
+{
+  // Knuth's multiplicative hash
+  return (((uint32_t) pixel) * 2654435761U) >> 8;
+}
+
+static
+void clearTable(struct QsWin *win)
+{
+  int i;
+  for(i = 0; i < TABLE_SIZE; ++i)
+    win->binTable[i] = -1;
+  win->numBins = 0;
+  win->haveBin = false;
+}
+
+static
+void cleanupPoints(struct QsWin *win)
+{
+  if(win->pointStamp)
+    g_free(win->pointStamp);
+  if(win->points)
+  {
+    g_free(win->points);
+    g_free(win->sortedPoints);
+    g_free(win->pointBin);
+  }
+  win->pointStamp = NULL;
+  win->points = win->sortedPoints = NULL;
+  win->pointBin = NULL;
+  win->npoints = win->pointsLen = 0;
+}
+
+// Returns the bin index for X11 pixel color, making one if it's not
+// there already.
+uint16_t _qsWin_getPointBin(struct QsWin *win, unsigned long pixel)
+{
+  QS_ASSERT(win);
+  uint32_t i;
+
+  if(!win->bins)
+  {
+    win->bins = g_malloc0(sizeof(*win->bins)*QS_MAX_POINT_BINS);
+    win->binTable = g_malloc(sizeof(*win->binTable)*TABLE_SIZE);
+    clearTable(win);
+  }
+
+  for(i = hashPixel(pixel) & (TABLE_SIZE - 1); win->binTable[i] != -1;
+      i = (i + 1) & (TABLE_SIZE - 1))
+    if(win->bins[win->binTable[i]].pixel == pixel)
+      return win->binTable[i];
+
+  if(win->numBins == QS_MAX_POINT_BINS)
+  {
+    // Too many colors.  We draw what we have and start over.
+    _qsWin_drawPoints(win);
+    clearTable(win);
+    i = hashPixel(pixel) & (TABLE_SIZE - 1);
+  }
+
+  win->binTable[i] = win->numBins;
+  win->bins[win->numBins].pixel = pixel;
+  return win->numBins++;
+}
+
+// Draw all the points in the point buffer.
+void _qsWin_flushPointBins(struct QsWin *win)
+{
+  QS_ASSERT(win && win->gc);
+  QS_ASSERT(win->pointStamp);
+
+  Drawable d;
+  int i, k, w, n, start;
+  const uint32_t *stamp;
+  struct QsPointBin *bins;
+  XPoint *p;
+  uint16_t *pb;
+
+  d = (win->pixmap)?win->pixmap:win->xwin;
+  w = win->width;
+  stamp = win->pointStamp;
+  bins = win->bins;
+  p = win->points;
+  pb = win->pointBin;
+  n = win->npoints;
+
+  for(k = 0; k < win->numBins; ++k)
+    bins[k].n = 0;
+
+  // Count the points in each bin, and remove the points that got
+  // drawn over in this batch.
+  for(i = 0; i < n; ++i)
+  {
+    if(stamp[w * p[i].y + p[i].x] == win->pointSeq + i + 1)
+      ++bins[pb[i]].n;
+    else
+      pb[i] = QS_MAX_POINT_BINS;
+  }
+
+  start = 0;
+  for(k = 0; k < win->numBins; ++k)
+  {
+    bins[k].start = start;
+    start += bins[k].n;
+  }
+
+  for(i = 0; i < n; ++i)
+    if(pb[i] != QS_MAX_POINT_BINS)
+      win->sortedPoints[bins[pb[i]].start++] = p[i];
+
+  // Now bins[k].start is at the end of bin k.
+  for(k = 0; k < win->numBins; ++k)
+  {
+    if(!bins[k].n)
+      continue;
+    if(win->xFGColor != bins[k].pixel)
+    {
+      XSetForeground(win->dsp, win->gc, bins[k].pixel);
+      win->xFGColor = bins[k].pixel;
+    }
+    XDrawPoints(win->dsp, d, win->gc,
+        win->sortedPoints + bins[k].start - bins[k].n, bins[k].n,
+        CoordModeOrigin);
+  }
+
+  win->pointSeq += n;
+  win->npoints = 0;
+  win->needPostPointDraw = true;
+}
+
+// Drop all the points that are not drawn yet and make the point
+// buffer and pixel stamps for the new window size, if we will use
+// them.
+void _qsWin_resizePointBins(struct QsWin *win)
+{
+  QS_ASSERT(win);
+  int len;
+
+  cleanupPoints(win);
+
+  if(win->fb || win->gl)
+    // xDrawPoint() never buffers points for the frame buffer or
+    // OpenGL, so we don't need the point buffer.
+    return;
+
+  win->pointStamp = g_malloc0(sizeof(*win->pointStamp)*
+      win->width*win->height);
+
+  len = win->width*win->height;
+  if(qsApp->op_pointBufferSize > 0 && len > qsApp->op_pointBufferSize)
+    len = qsApp->op_pointBufferSize;
+  win->pointsLen = len;
+  win->points = g_malloc(sizeof(*win->points)*len);
+  win->sortedPoints = g_malloc(sizeof(*win->sortedPoints)*len);
+  win->pointBin = g_malloc(sizeof(*win->pointBin)*len);
+}
+
+void _qsWin_cleanupPointBins(struct QsWin *win)
+{
+  QS_ASSERT(win);
+
+  if(win->bins)
+  {
+    g_free(win->bins);
+    g_free(win->binTable);
+  }
+  win->bins = NULL;
+  win->binTable = NULL;
+  win->numBins = 0;
+  win->haveBin = false;
+  cleanupPoints(win);
+}
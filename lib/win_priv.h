@@ -14,11 +14,126 @@
 
 #define SMALL_LDBL  (-1.0e-30)
 
+/* The fade surface is a pixel map with one of these per drawing area
+ * pixel.  tick is the fade queue tick (time bucket) that the pixel is
+ * queued in, or 0 if the pixel is not fading, in which case the pixel
+ * is the background color in win->bgPlane.  Colors fade from r,g,b to
+ * the win->bgPlane color as the intensity of the tick goes from 1 to
+ * 0. */
+struct QsFadePixel
+{
+  uint32_t tick;
+  uint8_t r, g, b;
+};
+
+/* A background restore color in win->bgPlane.  It's padded to 32 bits
+ * so that the fade blend reads one aligned word per pixel. */
+struct QsBgPixel
+{
+  uint8_t r, g, b, x;
+};
+
+/* The pixels that were drawn with a t0 in the time interval
+ * (tBase + (tick-1)*dt, tBase + tick*dt], like a line at the DMV
+ * (department of motor vehicles) where everyone that came in at
+ * about the same time gets the same number. */
+struct QsFadeBucket
+{
+  /* pixel indexes, like y * win->width + x.  A pixel index may be
+   * in here that is stale, that is it's fadeSurface[i].tick is not
+   * this tick any more; we just skip those. */
+  uint32_t *index;
+  uint32_t len, alloc;
+  uint32_t tick;
+};
+
+/* A ring buffer of time buckets, a bucket for each fade draw time
+ * tick.  Adding a pixel is just appending to a bucket array, and
+ * when a bucket is faded out we expire the whole bucket at once,
+ * so there is no list to search and keep in order. */
+struct QsFadeQueue
+{
+  struct QsFadeBucket *bucket; // ring buffer of numBuckets
+  uint32_t numBuckets;
+  uint32_t front; // oldest tick that may have pixels in it
+  size_t count; // number of indexes in all buckets, stale ones too
+  long double tBase, dt; // for converting between time and ticks
+  // The dirty rectangle of the pixels that a fade worker thread
+  // drew in this queue's tile, like win->fbXMin and so on.
+  int xMin, yMin, xMax, yMax;
+};
+
+// The latest time in the tick.  We use it for the intensity of all
+// the pixels in the tick, so pixels never fade early.
+static inline
+long double _qsFadeQueue_tickTime(const struct QsFadeQueue *q, uint32_t tick)
+{
+  return q->tBase + q->dt * tick;
+}
+
+/* A color in the density fade engine color ramp.  The ramp is indexed
+ * by hit count >> QS_DENSITY_RAMP_SHIFT. */
+struct QsDensityColor
+{
+  unsigned long pixel; /* X11 pixel color value */
+  uint8_t r, g, b;
+};
+
+#define QS_DENSITY_RAMP_SHIFT  6
+#define QS_DENSITY_RAMP_LEN    (0x10000 >> QS_DENSITY_RAMP_SHIFT)
+
+/* The number of bits we keep for each r,g,b color value.  On
+ * TrueColor visuals we compute the X11 pixel values, so there is
+ * no cost to using 8 bits.  The fade gradients look better with 8
+ * bits. */
+#define QS_COLOR_BITS  8
+
+/* With other visuals colors come from XAllocColor() and the hash
+ * table, so there we drop to 6 bits (64 values for each r,g,b,
+ * 2^18 = 262144 colors), which cuts down on the number of colors
+ * and the size of the color hash table. */
+#define QS_HASH_COLOR_BITS  6
+#define HASH_CMAX ((1 << QS_HASH_COLOR_BITS) - 1)
+
+#define RMAX ((1 << QS_COLOR_BITS) - 1)
+#define GMAX ((1 << QS_COLOR_BITS) - 1)
+#define BMAX ((1 << QS_COLOR_BITS) - 1)
+
+/* The most X11 pixel colors that we buffer points for at a time */
+#define QS_MAX_POINT_BINS  512
+
+/* The X11 pixel color of points waiting to be drawn with
+ * XDrawPoints().  The points are in win->points. */
+struct QsPointBin
+{
+  unsigned long pixel;
+  int n, start; /* used when sorting points into bins */
+};
+
 struct QsWin;
+struct QsFrameBuffer;
+struct QsFadeThreads;
+struct QsBackgroundCache;
+struct QsRender;
+struct QsGL;
+struct QsTrace;
+
+/* The fade state from before a window resize that is still being
+ * mapped into the new fade surface, a few rows per fade draw. */
+struct QsFadeResample
+{
+  struct QsFadePixel *surface; // old fade surface
+  float *phosphor; // old phosphor intensities, or NULL
+  uint16_t *density; // old density counts, or NULL
+  int width, height; // old drawing area size
+  long double tBase, dt; // old fade queue ticks
+  int row; // next old row to resample
+};
 struct QsXColor
 {
   unsigned long pixel;/* X11 pixel color value */
   struct QsWin *win; /* so we can free it */
+  int hashKey; /* the hash table key points to this */
 };
 
 struct QsWin
@@ -75,12 +190,43 @@ struct QsWin
   // but since there is only one per QsWin we just make
   // it part of QsWin, making it faster by having less
   // pointers to dereference.  Speed is very important
-  // in this fade stuff.  We do a lot of iterating of lists.
-  // This fade stuff is the biggest performance hit of
-  // all the parts of Quickscope.  "fade" is the fade class
-  // "namespace" within QsWin.
-
-  struct QsFadingColor *fadeSurface, *fadeFront, *fadeRear, *fadeLastInsert;
+  // in this fade stuff.  This fade stuff is the biggest
+  // performance hit of all the parts of Quickscope.
+  // "fade" is the fade class "namespace" within QsWin.
+
+  struct QsFadePixel *fadeSurface; // width*height pixels
+  /* The drawing area is cut into numFadeTiles horizontal tiles, each
+   * with its own fade queue, so that the tiles can be fade drawn in
+   * parallel by fadeThreads.  Pixel index i is in the fade queue
+   * fadeQueue[i/fadeTilePixels].  Without worker threads there is
+   * just one tile and fadeThreads is NULL. */
+  struct QsFadeQueue *fadeQueue; // array of numFadeTiles
+  int numFadeTiles;
+  uint32_t fadeTilePixels; // width * (rows in a tile)
+  struct QsFadeThreads *fadeThreads;
+  // Not NULL if we are still resampling the fade surface from
+  // before a resize.
+  struct QsFadeResample *fadeResample;
+
+  int fadeEngine; // enum QsFadeEngine
+  /* The phosphor fade engine keeps a trace intensity for each pixel
+   * in phosphor, and the bounding rectangle of the lit pixels.  The
+   * colors are in fadeSurface, with tick set to 1 if the pixel is
+   * lit.  phosphor is NULL if we are not using it. */
+  float *phosphor; // width*height
+  int phXMin, phYMin, phXMax, phYMax;
+  float phosphorHit; // intensity added to a pixel by a trace draw
+  float phosphorMax; // the most intensity a pixel can have
+
+  /* The density fade engine counts the trace hits on each pixel in
+   * 8.8 fixed point, so one hit is 256.  The counts decay with time
+   * and are drawn with the colors in densityRamp.  Like with phosphor,
+   * tick in fadeSurface is 1 if the pixel is lit.  density is NULL if
+   * we are not using it. */
+  uint16_t *density; // width*height
+  int dnXMin, dnYMin, dnXMax, dnYMax;
+  float densityDecay; // decay that is not applied to the counts yet
+  struct QsDensityColor *densityRamp; // QS_DENSITY_RAMP_LEN colors
   long double fadeLastTime; // last time _qsWin_fadeDraw() was called.
   /* user controllable fade parameters */
   float fadePeriod, fadeDelay, fadeMaxDrawPeriod;
@@ -94,6 +240,32 @@ struct QsWin
 
   Pixmap pixmap; /* if double buffered */
 
+  /* If we are using the frame buffer back end (op_frameBuffer),
+   * points are drawn into this in process image, indexed like
+   * fb[y * fbStride + x], and not with XDrawPoints().  fb is NULL
+   * if we are not using it. */
+  uint32_t *fb;
+  int fbStride;
+  /* The part of fb that needs to be sent to the X server.
+   * It's empty if fbXMax < fbXMin. */
+  int fbXMin, fbYMin, fbXMax, fbYMax;
+  struct QsFrameBuffer *frameBuffer; /* X11 image stuff */
+
+  /* The last background drawn by _qsWin_drawBackground(), so we
+   * don't need to draw the grid again if nothing changed. */
+  struct QsBackgroundCache *bgCache;
+
+  /* If not NULL, the window is drawn by its own render thread with
+   * its own X11 connection (op_renderThread).  The main thread must
+   * call _qsWin_renderPause() before it changes anything that the
+   * render thread draws with. */
+  struct QsRender *render;
+
+  /* If not NULL, we draw with OpenGL in the GtkGLArea win->da and
+   * not with libX11 (op_gl).  Always NULL if not built with
+   * --enable-gl. */
+  struct QsGL *gl;
+
   uint8_t bgR, bgG, bgB, /* background color */
     gridR, gridG, gridB, /* grid color */
     axisR, axisG, axisB, /* axis color */
@@ -102,9 +274,11 @@ struct QsWin
 
   /* color to revert to if the trace pixel is not drawn.
    * Includes grid, axis, ticks and subgrid.
-   * Index like r[y * win->width + x] where x and y of
-   * X11 pixel coordinates in the drawing area. */
-  uint8_t *r, *g, *b;
+   * Index like bgPlane[y * win->width + x] where x and y of
+   * X11 pixel coordinates in the drawing area.  bgPlaneAlloc is the
+   * number of pixels allocated, so we keep it if the window shrinks. */
+  struct QsBgPixel *bgPlane;
+  size_t bgPlaneAlloc;
 
   uint8_t gridXLineUnits, gridYLineUnits; // This is the spacing unit
   // between grid lines with factors of 10 removed; it's 1, 2, or 5
@@ -136,35 +310,56 @@ struct QsWin
   unsigned long bg; /* X11 pixel color of background color */
 
 
-  /* To keep from setting the same foreground color again and again */
+  /* The color that xDrawPoint() draws with */
   unsigned long lastFGColor;
+  /* To keep from setting the same X11 GC foreground color
+   * again and again */
+  unsigned long xFGColor;
  
-  /* We buffer up the pixel point draws */
-  XPoint *points;
-  size_t pointsLen;
-  int npoints;
+  /* We buffer up the pixel point draws and sort them into bins
+   * of the same color when we draw them, see win_pointBins.c */
+  struct QsPointBin *bins;
+  int16_t *binTable; /* open addressed hash of bins indexes */
+  int numBins;
+  uint16_t binIndex; /* bin of lastFGColor */
+  bool haveBin; /* binIndex is set */
+
+  /* The point buffer, and the bin of each point in it.  These are
+   * allocated at window resize and never grow. */
+  XPoint *points, *sortedPoints;
+  uint16_t *pointBin;
+  int npoints, pointsLen;
+
+  /* For each pixel the sequence number of the last point drawn
+   * there, indexed like pointStamp[y * width + x].  The sequence
+   * number of points[i] is pointSeq + i + 1. */
+  uint32_t *pointStamp, pointSeq;
 
   /* We store the X colors in a hash table so we do not have
    * to get the colors again and again. */
   GHashTable *hashTable;
 
+  /* For TrueColor visuals we compute X11 pixel values with
+   * pixel = redPixel[r] | greenPixel[g] | bluePixel[b]
+   * and do not use the hash table. */
+  bool trueColor;
+  unsigned long redPixel[RMAX+1], greenPixel[GMAX+1], bluePixel[BMAX+1];
+
   int width, height; /* drawing area window width and height */
 
   int swipePointCount; /* window global counter used by trace swipe */
+  /* The swipe id of the trace that is drawn on top at each pixel, or
+   * 0 for none.  It's width*height bytes, made by the first swiping
+   * trace.  swipeTopWidth and swipeTopHeight are the window size it
+   * was made for. */
+  uint8_t *swipeTop;
+  int swipeTopWidth, swipeTopHeight;
 };
 
-/* To cut down on the number of colors and the size
- * of the color hash table we use to 6 bits (64 values)
- * for each r,g,b.  That is 2^18 = 262144 colors.
- * Adding an additional green bit may not be a bad idea,
- * but we thought that it looked okay without it.
- * As you may know humans are more sensitive to green
- * then red and blue. */
-#define RMAX (0x3F) // first 6 bits
-#define GMAX (0x3F) // first 6 bits
-#define BMAX (0x3F) // first 6 bits
-
-#define MIN_INTENSITY (1.0F/((float)GMAX))
+/* Pixels fainter than this are dropped.  It stays at one step of a
+ * 6 bit color, because the fade rate is set from it and the fade
+ * period, and going to 8 bits should not change how traces fade. */
+#define MIN_INTENSITY (1.0F/((float)HASH_CMAX))
 
 /* We are not using Cairo to draw because it is
  * much slower than this is. We tried three different
@@ -172,34 +367,6 @@ struct QsWin
  * cases that we dreamed up. Cairo sucks at real-time
  * animation.  It's too slow. */
 
-struct QsFadingColor
-{
-  /* This is a pixel map that adds temporal color fading
-   * along a doubly linked list.  The linked list is
-   * is added to as trace points are plotted.  We add
-   * new bright unfaded points to the rear of the list
-   * and fadeRear->next is the next point, and the front
-   * point is oldest and most faded, like a line at the
-   * DMV (department of motor vehicles). */
-  struct QsFadingColor *prev, *next;
-  /* Intensity decreases with time whereby making colors
-   * fade from r,g,b to win->r, win->g, win->b.  When a
-   * colors' intensity is zero it is removed from the
-   * list and that color gets set to win->r, win->g, win->b.
-   * until it is drawn on again.  This intensity is a simple
-   * linear function of time. */
-
-  /* t0 is the time that the point was added plus the
-   * fade Delay time.  Similar to your customer number
-   * when you stand in line at the DMV.  When
-   * period + t0 - t is zero the intensity of the
-   * corresponding pixel, which t is the current wall clock
-   * time from gettimeofday().  t0 is always increasing from
-   * front (low) to rear (high). */
-  long double t0;
-  uint8_t r, g, b;
-};
-
 /* Returns pointer to cairo_surface_t on success, and NULL on failure.
  * Use g_free() on errorStr and cairo_surface_destroy() on returned value
  * if non-NULL, and g_free(*data). */
@@ -210,12 +377,21 @@ extern
 cairo_surface_t * _qsWin_savePNGwithAphas(struct QsWin *win,
     float alpha, float bgAlpha, char **errorStr, uint32_t **data);
 extern
+bool _qsWin_canGetImage(struct QsWin *win);
+extern
+void _qsWin_getImage(struct QsWin *win, float alpha, float bgAlpha,
+    uint32_t *data, int stride, char **feedbackStr);
+extern
+void _qsWin_snapshotCleanup(void);
+extern
 void _qsWin_setGridX(struct QsWin *win);
 extern
 void _qsWin_setGridY(struct QsWin *win);
 extern
 void _qsWin_drawBackground(struct QsWin *win);
 extern
+void _qsWin_backgroundCacheCleanup(struct QsWin *win);
+extern
 void _qsWin_reconfigure(struct QsWin *win);
 extern
 bool _qsWin_cb_configure(GtkWidget *da, GdkEvent *e, struct QsWin *win);
@@ -223,6 +399,9 @@ extern
 void _qsWin_drawTracePoint(struct QsWin *win, int x, int y,
     float r, float g, float b, long double t);
 extern
+void _qsWin_drawTracePoints(struct QsWin *win, const XPoint *p, int n,
+    float r, float g, float b, long double t);
+extern
 bool _qsWin_fadeDraw(struct QsWin *win);
 extern
 void _qsWin_updateStatusbar(struct QsWin *win);
@@ -246,8 +425,125 @@ extern
 void _qsWin_initFadeCallback(struct QsWin *win);
 extern
 void _qsWin_traceFadeRedraws(struct QsWin *win);
+extern
+bool _qsWin_frameBufferCreate(struct QsWin *win);
+extern
+void _qsWin_frameBufferDestroy(struct QsWin *win);
+extern
+void _qsWin_frameBufferFill(struct QsWin *win, unsigned long pixel);
+extern
+void _qsWin_frameBufferSetDirty(struct QsWin *win);
+extern
+void _qsWin_frameBufferFlush(struct QsWin *win);
+extern
+uint16_t _qsWin_getPointBin(struct QsWin *win, unsigned long pixel);
+extern
+void _qsWin_flushPointBins(struct QsWin *win);
+extern
+void _qsWin_resizePointBins(struct QsWin *win);
+extern
+void _qsWin_cleanupPointBins(struct QsWin *win);
+extern
+void _qsWin_fadeInit(struct QsWin *win);
+extern
+void _qsWin_fadeCleanup(struct QsWin *win);
+extern
+void _qsWin_fadeRebucket(struct QsWin *win);
+extern
+bool _qsWin_renderCreate(struct QsWin *win);
+extern
+void _qsWin_renderDestroy(struct QsWin *win);
+extern
+void _qsWin_renderPublish(struct QsWin *win);
+extern
+void _qsWin_renderPause(struct QsWin *win);
+extern
+void _qsWin_renderResume(struct QsWin *win);
+#ifdef QS_GL
+extern
+GtkWidget *_qsWin_glCreate(struct QsWin *win);
+extern
+void _qsWin_glDestroy(struct QsWin *win);
+extern
+void _qsWin_glAddPoints(struct QsWin *win, const XPoint *p, int n,
+    float r, float g, float b, long double t);
+extern
+void _qsWin_glBackgroundChanged(struct QsWin *win);
+extern
+void _qsWin_glPostTraceDraw(struct QsWin *win, long double t);
+#endif
+extern
+void _qsWin_fadeResize(struct QsWin *win, int oldWidth, int oldHeight);
+extern
+void _qsWin_fadeResample(struct QsWin *win, bool all, bool draw);
+extern
+void _qsWin_phosphorInit(struct QsWin *win);
+extern
+void _qsWin_phosphorCleanup(struct QsWin *win);
+extern
+void _qsWin_phosphorSetParams(struct QsWin *win);
+extern
+void _qsWin_phosphorDrawTracePoints(struct QsWin *win, const XPoint *p,
+    int n, uint8_t r, uint8_t g, uint8_t b);
+extern
+void _qsWin_phosphorDraw(struct QsWin *win, long double t);
+extern
+void _qsWin_phosphorRedraw(struct QsWin *win);
+extern
+void _qsWin_densityInit(struct QsWin *win);
+extern
+void _qsWin_densityCleanup(struct QsWin *win);
+extern
+void _qsWin_densityDrawTracePoints(struct QsWin *win, const XPoint *p,
+    int n);
+extern
+void _qsWin_densityDraw(struct QsWin *win, long double t);
+extern
+void _qsWin_densityRedraw(struct QsWin *win);
+extern
+void _qsWin_fadeDrawTile(struct QsWin *win, struct QsFadeQueue *q,
+    long double t, bool direct);
+extern
+struct QsFadeThreads *_qsWin_fadeThreadsCreate(struct QsWin *win,
+    int numThreads);
+extern
+void _qsWin_fadeThreadsDestroy(struct QsFadeThreads *ft);
+extern
+void _qsWin_fadeThreadsRun(struct QsFadeThreads *ft, long double t);
+
+
+// The fade queue of the tile that has pixel index i.
+static inline
+struct QsFadeQueue *_qsWin_fadeQueueOf(const struct QsWin *win, uint32_t i)
+{
+  QS_ASSERT(i/win->fadeTilePixels < (uint32_t) win->numFadeTiles);
+  return win->fadeQueue + i/win->fadeTilePixels;
+}
+
+// Returns true if there are any pixels fading.
+static inline
+bool _qsWin_fadeIsQueued(const struct QsWin *win)
+{
+  int k;
+  if(win->fadeResample)
+    return true;
+  if(win->phosphor)
+    return (win->phXMax >= win->phXMin);
+  if(win->density)
+    return (win->dnXMax >= win->dnXMin);
+  for(k = 0; k < win->numFadeTiles; ++k)
+    if(win->fadeQueue[k].count)
+      return true;
+  return false;
+}
 
 
+static inline
+bool _qsWin_frameBufferIsDirty(const struct QsWin *win)
+{
+  return (win->fbXMax >= win->fbXMin);
+}
+
 static inline
 void _qsWin_drawPoints(struct QsWin *win)
 {
@@ -291,16 +587,7 @@ void _qsWin_drawPoints(struct QsWin *win)
        * some if not all that CPU usage into this one process.
        * So it looks like we are getting parallelization for free.
        */
-    if(win->pixmap)
-      XDrawPoints(win->dsp, win->pixmap, win->gc,
-        win->points, win->npoints, CoordModeOrigin);
-    else
-      XDrawPoints(win->dsp, win->xwin, win->gc,
-        win->points, win->npoints, CoordModeOrigin);
-    //printf("%d\n", win->npoints);
-
-    win->needPostPointDraw = true;
-    win->npoints = 0;
+    _qsWin_flushPointBins(win);
 #endif
   }
 }
@@ -308,18 +595,31 @@ void _qsWin_drawPoints(struct QsWin *win)
 static inline
 void _qsWin_postTraceDraw(struct QsWin *win, long double t)
 {
-  if((win->needPostPointDraw ||
-    (win->fadeFront && t >= win->fadeLastTime + win->fadeMaxDrawPeriod)
+#ifdef QS_GL
+  if(win->gl)
+  {
+    _qsWin_glPostTraceDraw(win, t);
+    return;
+  }
+#endif
+  if((win->needPostPointDraw || win->npoints ||
+    (win->fb && _qsWin_frameBufferIsDirty(win)) ||
+    (_qsWin_fadeIsQueued(win) && t >= win->fadeLastTime + win->fadeMaxDrawPeriod)
     ) && !qsApp->freezeDisplay)
   {
     if(win->fade)
        _qsWin_fadeDraw(win);
 
+    // All the points of this draw cycle, one XDrawPoints() per color.
+    _qsWin_drawPoints(win);
+
     // gtk_widget_queue_draw_area() does not give good results.
     // It's is not necessarily drawing at a good time.
     // We control all the drawing except when an expose event and
     // stuff like that calls our drawing area draw callback.
-    if(win->pixmap)
+    if(win->fb)
+      _qsWin_frameBufferFlush(win);
+    else if(win->pixmap)
       XCopyArea(win->dsp, win->pixmap, win->xwin, win->gc,
         0, 0, win->width, win->height, 0, 0);
     win->needPostPointDraw = false;
@@ -329,14 +629,34 @@ void _qsWin_postTraceDraw(struct QsWin *win, long double t)
 static inline
 void setTraceColor(struct QsWin *win, unsigned long foreground)
 {
-  if(win->lastFGColor == foreground) return;
+  if(win->fb)
+  {
+    // xDrawPoint() just uses it.
+    win->lastFGColor = foreground;
+    return;
+  }
+
+  if(win->haveBin && win->lastFGColor == foreground) return;
 
-  /* We flush any points to draw before we
-   * change the foreground color. */
+  /* We do not flush the points to draw when we change
+   * the color, we just switch to the bin for this color. */
+  win->lastFGColor = foreground;
+  win->binIndex = _qsWin_getPointBin(win, foreground);
+  win->haveBin = true;
+}
+
+/* For X11 drawing, other than with xDrawPoint(), that uses the
+ * GC foreground color, like XFillRectangle(). */
+static inline
+void _qsWin_setXForeground(struct QsWin *win, unsigned long foreground)
+{
+  /* We flush any points to draw before we draw other things. */
   _qsWin_drawPoints(win);
 
+  if(win->xFGColor == foreground) return;
+
   XSetForeground(win->dsp, win->gc, foreground);
-  win->lastFGColor = foreground;
+  win->xFGColor = foreground;
 }
 
 /* We buffer the point draws so that we use less
@@ -344,18 +664,36 @@ void setTraceColor(struct QsWin *win, unsigned long foreground)
 static inline
 void xDrawPoint(struct QsWin *win, int x, int y)
 {
-  if(win->pointsLen <= win->npoints)
+#ifdef QS_GL
+  if(win->gl)
+    // The trace points go to _qsWin_glAddPoints(), and there is
+    // nothing else to draw.
+    return;
+#endif
+  if(win->fb)
   {
-    win->pointsLen += 256;
-    win->points = g_realloc(win->points,
-        sizeof(*(win->points))*win->pointsLen);
+    win->fb[y * win->fbStride + x] = win->lastFGColor;
+    if(x < win->fbXMin) win->fbXMin = x;
+    if(x > win->fbXMax) win->fbXMax = x;
+    if(y < win->fbYMin) win->fbYMin = y;
+    if(y > win->fbYMax) win->fbYMax = y;
+    return;
   }
 
+  QS_ASSERT(win->haveBin);
+  QS_ASSERT(win->points);
+  QS_ASSERT(x >= 0 && x < win->width && y >= 0 && y < win->height);
+
+  if(win->npoints == win->pointsLen)
+    // It's full.  We never allocate here.
+    _qsWin_drawPoints(win);
+
   win->points[win->npoints].x = x;
-  win->points[win->npoints++].y = y;
+  win->points[win->npoints].y = y;
+  win->pointBin[win->npoints++] = win->binIndex;
+  win->pointStamp[y * win->width + x] = win->pointSeq + win->npoints;
 }
 
-// TODO: maybe this could be made faster???
 static inline
 unsigned long getXColor(struct QsWin *win, float r, float g, float b)
 {
@@ -373,6 +711,14 @@ unsigned long getXColor(struct QsWin *win, float r, float g, float b)
   QS_VASSERT(green >= 0 && green <= GMAX, "green=%d", green);
   QS_VASSERT(blue >= 0 && blue <= BMAX, "blue=%d", blue);
 
+  if(win->trueColor)
+    return win->redPixel[red] | win->greenPixel[green] |
+      win->bluePixel[blue];
+
+  red   >>= QS_COLOR_BITS - QS_HASH_COLOR_BITS;
+  green >>= QS_COLOR_BITS - QS_HASH_COLOR_BITS;
+  blue  >>= QS_COLOR_BITS - QS_HASH_COLOR_BITS;
+
   hashKey = (red << 16) | (green << 8) | blue;
 
   /* Before this caching hash table we hammered the X server
@@ -384,9 +730,9 @@ unsigned long getXColor(struct QsWin *win, float r, float g, float b)
     return c->pixel;
 
   x.pixel = 0;
-  x.red   = (0xFFFF * red)/RMAX; /* X11 uses shorts not bytes */
-  x.green = (0xFFFF * green)/GMAX;
-  x.blue  = (0xFFFF * blue)/BMAX;
+  x.red   = (0xFFFF * red)/HASH_CMAX; /* X11 uses shorts not bytes */
+  x.green = (0xFFFF * green)/HASH_CMAX;
+  x.blue  = (0xFFFF * blue)/HASH_CMAX;
   x.flags = 0;
 
 #ifdef QS_DEBUG
@@ -398,8 +744,9 @@ unsigned long getXColor(struct QsWin *win, float r, float g, float b)
   c = g_malloc(sizeof(*c));
   c->pixel = x.pixel;
   c->win = win;
+  c->hashKey = hashKey;
 
-  g_hash_table_insert(win->hashTable, &hashKey, c);
+  g_hash_table_insert(win->hashTable, &c->hashKey, c);
 
   return x.pixel;
 }
@@ -436,7 +783,7 @@ bool _qsWin_isGridStuff(struct QsWin *win)
 }
 
 static inline
-unsigned long fadeColor(struct QsWin *win, struct QsFadingColor *fc,
+unsigned long fadeColor(struct QsWin *win, const struct QsFadePixel *fc,
     int w, int x, int y, float intensity)
 {
   float fade;
@@ -444,10 +791,46 @@ unsigned long fadeColor(struct QsWin *win, struct QsFadingColor *fc,
   i = w * y + x;
   QS_ASSERT(intensity >= MIN_INTENSITY && intensity < 1.0F);
 
+  const struct QsBgPixel *bp;
+  bp = win->bgPlane + i;
   fade = 1.0F - intensity;
 
   return getXColor(win,
-      fc->r * intensity + fade * win->r[i],
-      fc->g * intensity + fade * win->g[i],
-      fc->b * intensity + fade * win->b[i]);
+      fc->r * intensity + fade * bp->r,
+      fc->g * intensity + fade * bp->g,
+      fc->b * intensity + fade * bp->b);
+}
+
+// Old pixel o of oldN pixels maps to new pixels [*a, *b) of n.  For
+// keeping the fade and swipe pixels at a window resize.
+static inline
+void _qsWin_resampleSpan(int o, int oldN, int n, int *a, int *b)
+{
+  *a = (o * n)/oldN;
+  *b = ((o + 1) * n)/oldN;
+  if(*b <= *a)
+    *b = *a + 1;
+}
+
+// Set the whole background plane to the background color.
+static inline
+void _qsWin_bgPlaneFill(struct QsWin *win)
+{
+  struct QsBgPixel *bp, *end, c;
+  c.r = win->bgR;
+  c.g = win->bgG;
+  c.b = win->bgB;
+  c.x = 0;
+  end = win->bgPlane + win->width*win->height;
+  for(bp = win->bgPlane; bp < end; ++bp)
+    *bp = c;
+}
+
+// The X11 pixel of the background restore color at pixel index i.
+static inline
+unsigned long bgPlaneColor(struct QsWin *win, uint32_t i)
+{
+  const struct QsBgPixel *bp;
+  bp = win->bgPlane + i;
+  return getXColor(win, bp->r, bp->g, bp->b);
 }
@@ -0,0 +1,318 @@
+/* Quickscope - a software oscilloscope
+ * Copyright (C) 2012-2014  Lance Arsenault
+ * GNU General Public License version 3
+ */
+
+// A render thread for a window (op_renderThread).  The source reads,
+// GTK+ events, and adjusters stay in the main thread.  The trace
+// rasterizing, fade drawing, and flushing to X11 of each window is
+// done by the window's own thread, on its own clock, so that windows
+// render in parallel and the main thread does not wait for them.
+//
+// After a source read the main thread just tells the render threads
+// of the windows that the source draws in that there is new data, with
+// _qsWin_renderPublish(), and goes on.  The render thread then drains
+// its traces' iterators.  The iterators read the source ring buffers,
+// so that part is done holding the source lock (see source.c), which
+// the main thread holds while it writes the sources.  The fade drawing
+// and the flushing to X11, which are the slow parts, are done without
+// it.  With fade on, the render thread also wakes up every
+// fadeMaxDrawPeriod to keep fading when there is no new data.
+//
+// The render thread has its own X11 Display connection and GC, which
+// it swaps into win->dsp and win->gc while it draws.  When the main
+// thread needs the window, like for a resize, a reconfigure, an expose
+// or destroy, it pauses the render thread with _qsWin_renderPause(),
+// which waits for the render cycle to finish.  So no window is ever
+// drawn by two threads at the same time, and each Display connection
+// is only used by one thread at a time, so we do not need
+// XInitThreads().
+
+#include <math.h>
+#include <string.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <X11/Xlib.h>
+#include <gtk/gtk.h>
+#include "debug.h"
+#include "Assert.h"
+#include "base.h"
+#include "app.h"
+#include "app_priv.h"
+#include "timer_priv.h"
+#include "adjuster.h"
+#include "adjuster_priv.h"
+#include "win.h"
+#include "win_priv.h"
+#include "trace.h"
+#include "trace_priv.h"
+#include "group.h"
+#include "source.h"
+#include "source_priv.h"
+
+
+struct QsRender
+{
+  struct QsWin *win;
+  GThread *thread;
+
+  // The render thread X11 connection, and the main thread one that
+  // we put back in win when the render thread is done drawing.
+  Display *dsp, *mainDsp;
+  GC gc, mainGC;
+  unsigned long xFGColor, mainXFGColor;
+
+  GMutex mutex;
+  GCond startCond, doneCond;
+  // These are protected by the mutex.
+  int pause; // the main thread has the window if not 0
+  bool publish; // there is new source data to draw
+  bool busy; // the render thread is drawing
+  bool quit;
+};
+
+
+// Give the window to the render thread connection.
+static inline
+void swapIn(struct QsRender *r, struct QsWin *win)
+{
+  r->mainDsp = win->dsp;
+  r->mainGC = win->gc;
+  r->mainXFGColor = win->xFGColor;
+  win->dsp = r->dsp;
+  win->gc = r->gc;
+  win->xFGColor = r->xFGColor;
+}
+
+// Give the window back to the main thread connection.
+static inline
+void swapOut(struct QsRender *r, struct QsWin *win)
+{
+  r->xFGColor = win->xFGColor;
+  win->dsp = r->mainDsp;
+  win->gc = r->mainGC;
+  win->xFGColor = r->mainXFGColor;
+}
+
+static
+gpointer renderThread(struct QsRender *r)
+{
+  struct QsWin *win;
+  win = r->win;
+
+  g_mutex_lock(&r->mutex);
+  while(true)
+  {
+    GSList *l;
+    long double t;
+
+    // Wait for new data, or for the next fade draw.
+    while(!r->quit && (r->pause || !r->publish))
+    {
+      if(!r->pause && win->fade)
+      {
+        if(!g_cond_wait_until(&r->startCond, &r->mutex,
+              g_get_monotonic_time() +
+              (gint64) (win->fadeMaxDrawPeriod * G_TIME_SPAN_SECOND)) &&
+            !r->pause)
+          // Time to fade.
+          break;
+      }
+      else
+        g_cond_wait(&r->startCond, &r->mutex);
+    }
+    if(r->quit)
+      break;
+    r->publish = false;
+    g_mutex_unlock(&r->mutex);
+
+    // We get the source lock before we mark ourselves busy, so that
+    // the main thread may pause us while it holds the source lock
+    // without a dead lock.
+    _qsSource_lock();
+
+    g_mutex_lock(&r->mutex);
+    if(r->pause || r->quit)
+    {
+      // We got paused while we waited for the lock.  We'll draw
+      // when we are resumed.
+      r->publish = true;
+      g_mutex_unlock(&r->mutex);
+      _qsSource_unlock();
+      g_mutex_lock(&r->mutex);
+      continue;
+    }
+    r->busy = true;
+    g_mutex_unlock(&r->mutex);
+
+    swapIn(r, win);
+    t = _qsTimer_get(qsApp->timer);
+
+    for(l = win->traces; l; l = l->next)
+      _qsTrace_draw((struct QsTrace *) l->data, t);
+
+    _qsSource_unlock();
+
+    _qsWin_postTraceDraw(win, t);
+    // No XSync() here.  The main thread syncs our connection when it
+    // pauses us and needs the window.
+    XFlush(r->dsp);
+
+    swapOut(r, win);
+
+    g_mutex_lock(&r->mutex);
+    r->busy = false;
+    g_cond_broadcast(&r->doneCond);
+  }
+  g_mutex_unlock(&r->mutex);
+
+  return NULL;
+}
+
+// Called after the window's X11 stuff is setup.  Returns false if we
+// could not make the X11 connection, and then the window is drawn by
+// the main thread.  The render thread starts paused, so the caller
+// must call _qsWin_renderResume() when it's done setting up the
+// window.
+bool _qsWin_renderCreate(struct QsWin *win)
+{
+  QS_ASSERT(win && win->dsp && win->gc);
+  QS_ASSERT(!win->render);
+
+  struct QsRender *r;
+  Display *dsp;
+
+  dsp = XOpenDisplay(DisplayString(win->dsp));
+  if(!dsp)
+  {
+    QS_SPEW("XOpenDisplay(\"%s\") failed\n", DisplayString(win->dsp));
+    return false;
+  }
+
+  r = g_malloc0(sizeof(*r));
+  r->win = win;
+  r->dsp = dsp;
+  r->gc = XCreateGC(dsp, win->xwin, 0, 0);
+  QS_ASSERT(r->gc);
+  r->xFGColor = win->bg;
+  XSetForeground(dsp, r->gc, r->xFGColor);
+  r->pause = 1;
+  g_mutex_init(&r->mutex);
+  g_cond_init(&r->startCond);
+  g_cond_init(&r->doneCond);
+  r->thread = g_thread_new("QsRenderThread", (GThreadFunc) renderThread, r);
+
+  win->render = r;
+  return true;
+}
+
+void _qsWin_renderDestroy(struct QsWin *win)
+{
+  QS_ASSERT(win);
+  struct QsRender *r;
+  r = win->render;
+  if(!r) return;
+
+  _qsWin_renderPause(win);
+
+  g_mutex_lock(&r->mutex);
+  r->quit = true;
+  g_cond_signal(&r->startCond);
+  g_mutex_unlock(&r->mutex);
+  g_thread_join(r->thread);
+
+  XFreeGC(r->dsp, r->gc);
+  XCloseDisplay(r->dsp);
+  g_cond_clear(&r->startCond);
+  g_cond_clear(&r->doneCond);
+  g_mutex_clear(&r->mutex);
+#ifdef QS_DEBUG
+  memset(r, 0, sizeof(*r));
+#endif
+  g_free(r);
+  win->render = NULL;
+}
+
+// Tell the render thread that a source that it draws has new data.
+// This does not wait.
+void _qsWin_renderPublish(struct QsWin *win)
+{
+  QS_ASSERT(win && win->render);
+  struct QsRender *r;
+  r = win->render;
+
+  g_mutex_lock(&r->mutex);
+  if(!r->publish)
+  {
+    r->publish = true;
+    g_cond_signal(&r->startCond);
+  }
+  g_mutex_unlock(&r->mutex);
+}
+
+// Wait for the render thread to finish its render cycle, and keep it
+// from drawing, so that the main thread may use the window.  Does
+// nothing if there is no render thread.  Calls may be nested, with a
+// _qsWin_renderResume() for each.
+void _qsWin_renderPause(struct QsWin *win)
+{
+  QS_ASSERT(win);
+  struct QsRender *r;
+  r = win->render;
+  if(!r) return;
+
+  bool first;
+
+  g_mutex_lock(&r->mutex);
+  first = (r->pause++ == 0);
+  while(r->busy)
+    g_cond_wait(&r->doneCond, &r->mutex);
+  g_mutex_unlock(&r->mutex);
+
+  if(first)
+    // The render thread connection requests must be done before the
+    // main thread draws on the pixmap or window, or changes the frame
+    // buffer, with its connection.  The render thread is not using
+    // its connection now, so we may.
+    XSync(r->dsp, False);
+}
+
+void _qsWin_renderResume(struct QsWin *win)
+{
+  QS_ASSERT(win);
+  struct QsRender *r;
+  r = win->render;
+  if(!r) return;
+
+  g_mutex_lock(&r->mutex);
+  QS_ASSERT(r->pause > 0);
+  if(--r->pause == 0)
+  {
+    // Draw the traces on what the main thread drew, like a new
+    // background after a resize.  This is not for every render
+    // cycle, just when the window is handed back.
+    XSync(win->dsp, False);
+    r->publish = true;
+    g_cond_signal(&r->startCond);
+  }
+  g_mutex_unlock(&r->mutex);
+}
+
+// Pause all the render threads, for when something that many windows
+// may draw with changes, like an adjuster value.
+void _qsApp_renderPause(void)
+{
+  GSList *l;
+  if(!qsApp) return;
+  for(l = qsApp->wins; l; l = l->next)
+    _qsWin_renderPause((struct QsWin *) l->data);
+}
+
+void _qsApp_renderResume(void)
+{
+  GSList *l;
+  if(!qsApp) return;
+  for(l = qsApp->wins; l; l = l->next)
+    _qsWin_renderResume((struct QsWin *) l->data);
+}
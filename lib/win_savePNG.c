@@ -51,34 +51,15 @@ uint32_t GetColor(float a, float r, float g, float b,
   return GetARGBColor(a, r, g, b);
 }
 
-// It assumes all traces in the win have a swipe surface buffer.
 // Returns 1 if it does not write a color to ret else
 // returns 0 if it does write to ret.
 static inline
 int _qsWin_getTopSwipeColor(struct QsWin *win, float alpha,
-    int xyIndex, uint32_t bgARGB, uint32_t bgRGB,
+    int x, int y, uint32_t bgARGB, uint32_t bgRGB,
     uint32_t *ret)
 {
-  GSList *l;
-  int maxPointCount;
-  struct QsTrace *topTrace = NULL;
-  // Less than 1/2 of INT_MAX from win->swipePointCount
-  maxPointCount = win->swipePointCount - 6*(INT_MAX/13);
-  for(l = win->traces; l; l = l->next)
-  {
-    struct QsTrace *trace;
-    struct QsSwipeColor *sc;
-    trace = l->data;
-    QS_ASSERT(trace->swipe);
-    QS_ASSERT(trace->swipe->surface);
-    sc = trace->swipe->surface + xyIndex;
-    if((sc->next || sc == trace->swipe->end) &&
-        sc->pointCount - maxPointCount > 0)
-    {
-      topTrace = trace;
-      maxPointCount = sc->pointCount;
-    }
-  }
+  struct QsTrace *topTrace;
+  topTrace = _qsWin_swipeTopTrace(win, x, y);
 
   if(topTrace)
   {
@@ -93,12 +74,42 @@ int _qsWin_getTopSwipeColor(struct QsWin *win, float alpha,
 cairo_surface_t *_qsWin_savePNG(struct QsWin *win, char **feedbackStr,
     uint32_t **data)
 {
-  return _qsWin_savePNGwithAphas(win, qsApp->op_savePNG_bgAlpha,
+  cairo_surface_t *surface;
+  // So we get a whole frame, and not one that the render thread is
+  // drawing.
+  _qsWin_renderPause(win);
+  surface = _qsWin_savePNGwithAphas(win, qsApp->op_savePNG_bgAlpha,
       qsApp->op_savePNG_alpha, feedbackStr, data);
+  _qsWin_renderResume(win);
+  return surface;
+}
+
+static
+bool allSwipingTraces(const struct QsWin *win)
+{
+  GSList *l;
+  if(win->fade || !win->traces)
+    return false;
+  for(l = win->traces; l; l = l->next)
+    if(!((struct QsTrace *) l->data)->swipe)
+      return false;
+  return true;
+}
+
+// Returns true if we have what's drawn in this process, in the fading
+// color surface, the trace swipe buffers, or the frame buffer, so
+// that _qsWin_getImage() can make the image without the X server.
+bool _qsWin_canGetImage(struct QsWin *win)
+{
+  QS_ASSERT(win);
+  // The GL back end keeps its image in the GL context, not in the
+  // fade surface or frame buffer, so we don't have it here.
+  return (win->width > 0 && win->height > 0 && !win->gl &&
+      (win->fade || win->fb || allSwipingTraces(win)));
 }
 
 // Saves a PNG file from the fading color surface, trace swipe buffers,
-// x11 pixmap, or X11 drawing area window.
+// frame buffer, x11 pixmap, or X11 drawing area window.
 // feedbackStr must be freed with g_free()
 // returns a pointer to a cairo_surface_t.
 cairo_surface_t *_qsWin_savePNGwithAphas(struct QsWin *win,
@@ -106,26 +117,15 @@ cairo_surface_t *_qsWin_savePNGwithAphas(struct QsWin *win,
 {
   QS_ASSERT(win && win->gc);
 
-  bool allSwipingTraces = false;
+  cairo_surface_t *surface;
+  int stride;
 
   if(feedbackStr)
     *feedbackStr = NULL;
 
   // We do all the bailing cases first
 
-  if(!win->fade && win->traces)
-  {
-    GSList *l;
-    allSwipingTraces = true;
-    for(l = win->traces; l; l = l->next)
-      if(!((struct QsTrace *) l->data)->swipe)
-      {
-        allSwipingTraces = false;
-        break;
-      }
-  }
-
-  if(!win->fade && !allSwipingTraces && win->pixmap)
+  if(!_qsWin_canGetImage(win) && win->pixmap)
   {
     if(feedbackStr)
       *feedbackStr = g_strdup("using X11 pixmap");
@@ -133,7 +133,7 @@ cairo_surface_t *_qsWin_savePNGwithAphas(struct QsWin *win,
         gdk_x11_visual_get_xvisual(gdk_visual_get_system()),
         win->width, win->height);
   }
-  else if(!win->fade && !allSwipingTraces)
+  else if(!_qsWin_canGetImage(win))
   {
     if(feedbackStr)
       *feedbackStr = g_strdup("using drawing area X11 window");
@@ -142,30 +142,72 @@ cairo_surface_t *_qsWin_savePNGwithAphas(struct QsWin *win,
         win->width, win->height);
   }
 
+  stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, win->width);
+  *data = g_malloc(stride * win->height);
+  surface = cairo_image_surface_create_for_data((unsigned char*) (*data),
+      CAIRO_FORMAT_ARGB32, win->width, win->height, stride);
+  /* change stride from number of bytes to number of uint32_t */
+  _qsWin_getImage(win, alpha, bgAlpha, *data, stride/4, feedbackStr);
+
+  return surface;
+}
+
+// Writes the drawing area image as ARGB32 pixels, with premultiplied
+// alpha like cairo, into data which has stride uint32_t per row.
+// _qsWin_canGetImage() must be true.  This just reads this process's
+// memory, so it's fast enough to call for every snapshot.
+void _qsWin_getImage(struct QsWin *win, float alpha, float bgAlpha,
+    uint32_t *data, int stride, char **feedbackStr)
+{
+  QS_ASSERT(win && data);
+  QS_ASSERT(_qsWin_canGetImage(win));
+
+  bool swiping;
   int i, x, y, w, h;
-  uint8_t *wr, *wg, *wb;
+  const struct QsBgPixel *bp;
   uint32_t *row;
   uint32_t bgRGB, bgARGB;
-  cairo_surface_t *surface;
-  int stride;
 
-  wr = win->r; wg = win->g; wb = win->b;
   w = win->width;
   h = win->height;
-
-  stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, w);
-  *data = g_malloc(stride * h);
-  surface = cairo_image_surface_create_for_data((unsigned char*) (*data),
-      CAIRO_FORMAT_ARGB32, w, h, stride);
-  stride /= 4; /* change stride from number of bytes to number of uint32_t */
-  row = *data;
+  row = data;
+  swiping = allSwipingTraces(win);
 
   bgARGB = GetARGBColor(bgAlpha, win->bgR, win->bgG, win->bgB);
   bgRGB = GetRGBColor(win->bgR, win->bgG, win->bgB);
 
+  if(win->fb && !win->fade && !swiping)
+  {
+    // The frame buffer pixels are 0x00RRGGBB, see
+    // win_frameBuffer.c:visualIsOkay().
+    for(y=0;y<h;++y)
+    {
+      const uint32_t *fb;
+      fb = win->fb + y * win->fbStride;
+      for(x=0;x<w;++x)
+      {
+        uint32_t p;
+        p = fb[x] | 0xFF000000;
+        if(p == bgRGB)
+          row[x] = bgARGB;
+        else if(alpha == 1.0F)
+          row[x] = p;
+        else
+          row[x] = GetARGBColor(alpha,
+              ((p >> 16) & 0xFF) * RMAX/255.0F,
+              ((p >>  8) & 0xFF) * GMAX/255.0F,
+              ( p        & 0xFF) * BMAX/255.0F);
+      }
+      row += stride;
+    }
+    if(feedbackStr)
+      *feedbackStr = g_strdup("using frame buffer");
+    return;
+  }
+
   if(win->fade)
   {
-    struct QsFadingColor *fc;
+    struct QsFadePixel *fc;
     float fadeAlpha;
     long double fadeLastTime;
 #ifdef LINEAR_FADE
@@ -183,44 +225,65 @@ cairo_surface_t *_qsWin_savePNGwithAphas(struct QsWin *win,
       {
         i = w * y + x;
         
-        if(!fc->next && fc != win->fadeFront)
+        if(fc->tick && win->density)
+        {
+          // The color is from the hit count color ramp.
+          const struct QsDensityColor *c;
+          c = win->densityRamp + (win->density[i] >> QS_DENSITY_RAMP_SHIFT);
+          row[x] = GetColor(alpha, c->r, c->g, c->b, bgARGB, bgRGB);
+        }
+        else if(!fc->tick)
         {
-          // It's a pixel that is not in the fade linked list
+          // It's a pixel that is not in the fade queue
           // of trace pixels in the fade surface buffer.
-          /* The color is from the fixed background: wr[i], wg[i], wb[i] */
-          row[x] = GetColor(alpha, wr[i], wg[i], wb[i], bgARGB, bgRGB);
+          /* The color is from the fixed background plane */
+          bp = win->bgPlane + i;
+          row[x] = GetColor(alpha, bp->r, bp->g, bp->b, bgARGB, bgRGB);
         }
         else
         {
           float I; // trace point intensity
-          I = _qsWin_fadeIntensity(fadeAlpha, fc->t0, fadeLastTime);
+          if(win->phosphor)
+            I = win->phosphor[i];
+          else
+            I = _qsWin_fadeIntensity(fadeAlpha,
+                _qsFadeQueue_tickTime(_qsWin_fadeQueueOf(win, i), fc->tick),
+                fadeLastTime);
 
           if(I >= 1.0F)
           {
             /* color is fc->r, fc->g, fc->b */
             row[x] = GetColor(alpha, fc->r, fc->g, fc->b, bgARGB, bgRGB);
           }
-          else if(I > 0.0F)
+          else if(I >= MIN_INTENSITY)
           {
             /* color is computed as a function of intensity and two colors */
             float fade;
             fade = 1.0F - I;
+            bp = win->bgPlane + i;
 
             /* If there is an intensity than this is not the background color
              * but we will fade to the background if it is fading to it. */
 
-            if(GetRGBColor(wr[i], wg[i], wb[i]) == bgRGB)
+            if(GetRGBColor(bp->r, bp->g, bp->b) == bgRGB)
               row[x] = GetARGBColor(
                     (alpha * I + bgAlpha * fade),
-                    (fc->r * I + wr[i] * fade),
-                    (fc->g * I + wg[i] * fade),
-                    (fc->b * I + wb[i] * fade));
+                    (fc->r * I + bp->r * fade),
+                    (fc->g * I + bp->g * fade),
+                    (fc->b * I + bp->b * fade));
             else
               row[x] = GetARGBColor(
                     alpha,
-                    (fc->r * I + wr[i] * fade),
-                    (fc->g * I + wg[i] * fade),
-                    (fc->b * I + wb[i] * fade));
+                    (fc->r * I + bp->r * fade),
+                    (fc->g * I + bp->g * fade),
+                    (fc->b * I + bp->b * fade));
+          }
+          else
+          {
+            // It's faded out, but _qsWin_fadeDraw() has not
+            // removed it yet.
+            bp = win->bgPlane + i;
+            row[x] = GetColor(alpha, bp->r, bp->g, bp->b, bgARGB, bgRGB);
           }
         }
 
@@ -233,16 +296,19 @@ cairo_surface_t *_qsWin_savePNGwithAphas(struct QsWin *win,
       *feedbackStr = g_strdup("using fade buffer");
   }
   //else
-  if(allSwipingTraces)
+  if(swiping)
   {
     for(y=0;y<h;++y)
     {
       for(x=0;x<w;++x)
       {
         i = w * y + x;
-        if(_qsWin_getTopSwipeColor(win, alpha, i, bgARGB, bgRGB, &row[x]))
-          /* color is wr[i], wg[i], wb[i] */
-          row[x] = GetColor(alpha, wr[i], wg[i], wb[i], bgARGB, bgRGB);
+        if(_qsWin_getTopSwipeColor(win, alpha, x, y, bgARGB, bgRGB, &row[x]))
+        {
+          /* color is from the background plane */
+          bp = win->bgPlane + i;
+          row[x] = GetColor(alpha, bp->r, bp->g, bp->b, bgARGB, bgRGB);
+        }
       }
       row += stride;
     }
@@ -293,6 +359,4 @@ cairo_surface_t *_qsWin_savePNGwithAphas(struct QsWin *win,
       *feedbackStr = g_strdup("using drawing area X11 window");
   }
 #endif
-
-  return surface;
 }
@@ -0,0 +1,226 @@
+/* Quickscope - a software oscilloscope
+ * Copyright (C) 2012-2014  Lance Arsenault
+ * GNU General Public License version 3
+ */
+
+// qsWin_saveSnapshot() is for taking images of a window again and
+// again, like for logging.  The main thread just copies the image
+// out of this process's memory with _qsWin_getImage(), and a worker
+// thread does the slow part, the PNG encoding and file writing.  Only
+// if there is no in-process image (no fade, no swipe, and no frame
+// buffer) do we get the image from the X server.  GL windows are not
+// supported.
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <X11/Xlib.h>
+#include <cairo.h>
+#include <gtk/gtk.h>
+#include "debug.h"
+#include "Assert.h"
+#include "base.h"
+#include "app.h"
+#include "adjuster.h"
+#include "adjuster_priv.h"
+#include "win.h"
+#include "win_priv.h"
+
+
+// If this many snapshots are waiting for the worker we drop new ones,
+// so that a slow disk does not eat all the memory.
+#define MAX_QUEUED  8
+
+
+struct QsSnapshot
+{
+  char *filename;
+  enum QsSnapshotFormat format;
+  int width, height, stride; // stride is in uint32_t
+  uint32_t *data; // ARGB32, premultiplied alpha like cairo
+};
+
+// One worker thread for all windows, so the files get written in
+// order.
+static GThreadPool *pool = NULL;
+
+
+static
+bool writePPM(const struct QsSnapshot *s)
+{
+  FILE *file;
+  uint8_t *rgb;
+  int x, y;
+  bool ret = true;
+
+  errno = 0;
+  if(!(file = fopen(s->filename, "w")))
+  {
+    fprintf(stderr, "fopen(\"%s\",\"w\") failed: errno=%d: %s\n",
+        s->filename, errno, strerror(errno));
+    return false;
+  }
+
+  fprintf(file, "P6\n%d %d\n255\n", s->width, s->height);
+
+  rgb = g_malloc(3 * s->width);
+  for(y = 0; y < s->height && ret; ++y)
+  {
+    const uint32_t *row;
+    uint8_t *p;
+    row = s->data + y * s->stride;
+    p = rgb;
+    for(x = 0; x < s->width; ++x)
+    {
+      *p++ = row[x] >> 16;
+      *p++ = row[x] >> 8;
+      *p++ = row[x];
+    }
+    if(fwrite(rgb, 3, s->width, file) != (size_t) s->width)
+      ret = false;
+  }
+  g_free(rgb);
+
+  if(fclose(file) || !ret)
+  {
+    fprintf(stderr, "writing \"%s\" failed: errno=%d: %s\n",
+        s->filename, errno, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+static
+bool writePNG(const struct QsSnapshot *s)
+{
+  cairo_surface_t *surface;
+  cairo_status_t status;
+
+  surface = cairo_image_surface_create_for_data((unsigned char *) s->data,
+      CAIRO_FORMAT_ARGB32, s->width, s->height, s->stride * 4);
+  errno = 0;
+  status = cairo_surface_write_to_png(surface, s->filename);
+  cairo_surface_destroy(surface);
+
+  if(status != CAIRO_STATUS_SUCCESS)
+  {
+    fprintf(stderr, "cairo_surface_write_to_png(,\"%s\") failed:"
+        " %s: errno=%d: %s\n", s->filename,
+        cairo_status_to_string(status), errno, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+// The worker thread callback.
+static
+void writeSnapshot(struct QsSnapshot *s, gpointer unused)
+{
+  if(s->format == QS_SNAPSHOT_PPM)
+    writePPM(s);
+  else
+    writePNG(s);
+
+  QS_SPEW("saved snapshot \"%s\"\n", s->filename);
+
+  g_free(s->data);
+  g_free(s->filename);
+  g_free(s);
+}
+
+// Get the image from the X server, the slow way.
+static
+void getXImage(struct QsWin *win, float alpha, float bgAlpha,
+    struct QsSnapshot *s)
+{
+  cairo_surface_t *xSurface, *surface;
+  cairo_t *cr;
+  uint32_t *unused = NULL;
+
+  xSurface = _qsWin_savePNGwithAphas(win, alpha, bgAlpha, NULL, &unused);
+  QS_ASSERT(!unused);
+  surface = cairo_image_surface_create_for_data((unsigned char *) s->data,
+      CAIRO_FORMAT_ARGB32, s->width, s->height, s->stride * 4);
+  cr = cairo_create(surface);
+  cairo_set_source_surface(cr, xSurface, 0, 0);
+  cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+  cairo_paint(cr);
+  cairo_destroy(cr);
+  cairo_surface_destroy(surface);
+  cairo_surface_destroy(xSurface);
+}
+
+bool qsWin_saveSnapshot(struct QsWin *win, const char *filename,
+    enum QsSnapshotFormat format)
+{
+  QS_ASSERT(qsApp);
+  QS_ASSERT(filename && filename[0]);
+
+  struct QsSnapshot *s;
+  float alpha, bgAlpha;
+
+  win = qsWin_getDefault(win);
+  QS_ASSERT(win);
+
+  if(win->width <= 0 || win->height <= 0 || !win->bgPlane)
+  {
+    QS_SPEW("window is not drawn yet, no snapshot \"%s\"\n", filename);
+    return false;
+  }
+
+  if(win->gl)
+  {
+    // We'd need glReadPixels() in the GL context, and the X drawing
+    // area window is not where GL draws.
+    QS_SPEW("no snapshots of GL windows, no snapshot \"%s\"\n", filename);
+    return false;
+  }
+
+  if(!pool)
+    pool = g_thread_pool_new((GFunc) writeSnapshot, NULL, 1, FALSE, NULL);
+
+  if(g_thread_pool_unprocessed(pool) >= MAX_QUEUED)
+  {
+    QS_SPEW("%u snapshots are waiting, dropping \"%s\"\n",
+        g_thread_pool_unprocessed(pool), filename);
+    return false;
+  }
+
+  if(format == QS_SNAPSHOT_PPM)
+    // PPM has no alpha.
+    alpha = bgAlpha = 1.0F;
+  else
+  {
+    alpha = qsApp->op_savePNG_alpha;
+    bgAlpha = qsApp->op_savePNG_bgAlpha;
+  }
+
+  s = g_malloc(sizeof(*s));
+  s->filename = g_strdup(filename);
+  s->format = format;
+  s->width = win->width;
+  s->height = win->height;
+  s->stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32,
+      s->width)/4;
+  s->data = g_malloc(sizeof(uint32_t) * s->stride * s->height);
+
+  _qsWin_renderPause(win);
+  if(_qsWin_canGetImage(win))
+    _qsWin_getImage(win, alpha, bgAlpha, s->data, s->stride, NULL);
+  else
+    getXImage(win, alpha, bgAlpha, s);
+  _qsWin_renderResume(win);
+
+  g_thread_pool_push(pool, s, NULL);
+  return true;
+}
+
+// Waits for the queued snapshots to be written.
+void _qsWin_snapshotCleanup(void)
+{
+  if(!pool) return;
+  g_thread_pool_free(pool, FALSE, TRUE);
+  pool = NULL;
+}